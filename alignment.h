@@ -0,0 +1,259 @@
+#ifndef ALIGNMENT_H
+#define ALIGNMENT_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "canvas.h"
+
+class AlignmentSearchOptions
+{
+public:
+    int level_count = 3;           //金字塔层数,第0层为原分辨率,每层边长减半
+    double max_shift = 0.05;       //最大平移,画布边长的比例
+    int shift_step_count = 2;      //最粗层每个方向的平移步数,共(2n+1)^2种平移
+    double max_scale_ratio = 1.15; //相对面积比缩放的最大倍数
+    int scale_step_count = 2;      //最粗层的缩放步数,共2n+1种缩放
+    int top_count = 3;             //每层保留并细化的候选数
+};
+
+//一个对齐方式:在面积比缩放与中心对齐之后,再缩放scale_ratio倍并平移shift
+class AlignmentCandidate
+{
+public:
+    double scale_ratio = 1.0;
+    double shift_x = 0.0; //原分辨率像素
+    double shift_y = 0.0;
+    double iou = 0.0;
+};
+
+class AlignmentResult
+{
+public:
+    double iou = 0.0;
+    double scale = 1.0;  //测试字凸包最终的缩放倍数
+    cv::Point2d offset;  //测试字凸包顶点 p 对应2倍画布上的 p * scale + offset
+    AlignmentCandidate candidate;
+    double baseline_iou = 0.0; //只做中心对齐与面积比缩放时的得分
+    int evaluated_count = 0;   //各层共计算的候选数
+};
+
+/**
+ * @brief 由粗到细搜索测试字凸包的最佳缩放与平移
+ *
+ * 凸包只以顶点表示,每层按该层分辨率重新填充,不对图像缩放;
+ * 最粗层遍历整个网格,之后每层只在上一层最好的top_count个候选附近以一半的步长细化
+ * 中心对齐并按面积比缩放的原方案始终作为候选之一,结果不低于原方案
+ */
+class AlignmentSearcher
+{
+public:
+    /**
+     * @param standard_hull 标准字凸包顶点,原图坐标
+     * @param evaluate_hull 测试字凸包顶点,原图坐标
+     * @param extend_size 2倍画布尺寸
+     * @param standard_offset 标准字凸包在2倍画布上的平移
+     * @param fixed_center 缩放不动点,2倍画布坐标
+     * @param base_scale 面积比缩放倍数
+     * @param base_offset 中心对齐的平移,原方案中 p 对应 fixed_center + base_scale * (p + base_offset - fixed_center)
+     */
+    AlignmentSearcher(
+        const std::vector<cv::Point> &standard_hull,
+        const std::vector<cv::Point> &evaluate_hull,
+        cv::Size extend_size,
+        cv::Point2d standard_offset,
+        cv::Point2d fixed_center,
+        double base_scale,
+        cv::Point2d base_offset,
+        AlignmentSearchOptions options)
+        : m_evaluate_hull(evaluate_hull), m_fixed_center(fixed_center), m_base_scale(base_scale), m_base_offset(base_offset), m_options(options)
+    {
+        m_options.level_count = std::max(1, m_options.level_count);
+        for (auto level = 0; level < m_options.level_count; ++level)
+        {
+            auto factor = 1 << level;
+            cv::Size size((extend_size.width + factor - 1) / factor, (extend_size.height + factor - 1) / factor);
+            cv::Mat standard_mask = cv::Mat::zeros(size.height, size.width, CV_8UC1);
+            fill_hull(standard_mask, standard_hull, 1.0 / factor, cv::Point2d(standard_offset.x / factor, standard_offset.y / factor));
+            m_standard_masks.push_back(standard_mask);
+            m_evaluate_masks.push_back(cv::Mat::zeros(size.height, size.width, CV_8UC1));
+        }
+        m_extend_size = extend_size;
+    }
+    AlignmentResult search()
+    {
+        AlignmentResult result;
+        auto top_level = m_options.level_count - 1;
+        auto shift_step = m_options.max_shift * std::max(m_extend_size.width, m_extend_size.height) / 2 / std::max(1, m_options.shift_step_count);
+        auto log_scale_step = std::log(std::max(1.0, m_options.max_scale_ratio)) / std::max(1, m_options.scale_step_count);
+
+        //最粗层遍历网格
+        std::vector<AlignmentCandidate> candidates;
+        for (auto k = -m_options.scale_step_count; k <= m_options.scale_step_count; ++k)
+        {
+            for (auto i = -m_options.shift_step_count; i <= m_options.shift_step_count; ++i)
+            {
+                for (auto j = -m_options.shift_step_count; j <= m_options.shift_step_count; ++j)
+                {
+                    AlignmentCandidate candidate;
+                    candidate.scale_ratio = std::exp(k * log_scale_step);
+                    candidate.shift_x = i * shift_step;
+                    candidate.shift_y = j * shift_step;
+                    candidates.push_back(candidate);
+                }
+            }
+        }
+        auto top_candidates = select_top(candidates, top_level, result.evaluated_count);
+
+        //逐层细化
+        for (auto level = top_level - 1; level >= 0; --level)
+        {
+            shift_step /= 2;
+            log_scale_step /= 2;
+            candidates.clear();
+            for (auto &top_candidate : top_candidates)
+            {
+                for (auto k = -1; k <= 1; ++k)
+                {
+                    for (auto i = -1; i <= 1; ++i)
+                    {
+                        for (auto j = -1; j <= 1; ++j)
+                        {
+                            AlignmentCandidate candidate;
+                            candidate.scale_ratio = top_candidate.scale_ratio * std::exp(k * log_scale_step);
+                            candidate.shift_x = top_candidate.shift_x + i * shift_step;
+                            candidate.shift_y = top_candidate.shift_y + j * shift_step;
+                            candidates.push_back(candidate);
+                        }
+                    }
+                }
+            }
+            top_candidates = select_top(candidates, level, result.evaluated_count);
+        }
+
+        //原方案在原分辨率上的得分
+        AlignmentCandidate baseline;
+        baseline.iou = get_iou(baseline, 0);
+        ++result.evaluated_count;
+        result.baseline_iou = baseline.iou;
+        auto best = baseline;
+        if (!top_candidates.empty() && top_candidates[0].iou > baseline.iou)
+        {
+            best = top_candidates[0];
+        }
+        result.iou = best.iou;
+        result.candidate = best;
+        std::tie(result.scale, result.offset) = get_transform(best);
+        return result;
+    }
+
+protected:
+    //候选对应的 p * scale + offset,原分辨率2倍画布坐标
+    std::tuple<double, cv::Point2d> get_transform(const AlignmentCandidate &candidate) const
+    {
+        auto scale = m_base_scale * candidate.scale_ratio;
+        cv::Point2d offset(
+            m_fixed_center.x * (1 - scale) + m_base_offset.x * scale + candidate.shift_x,
+            m_fixed_center.y * (1 - scale) + m_base_offset.y * scale + candidate.shift_y);
+        return {scale, offset};
+    }
+    double get_iou(const AlignmentCandidate &candidate, int level)
+    {
+        auto factor = 1 << level;
+        auto [scale, offset] = get_transform(candidate);
+        scale /= factor;
+        offset.x /= factor;
+        offset.y /= factor;
+        auto &standard_mask = m_standard_masks[level];
+        auto &evaluate_mask = m_evaluate_masks[level];
+        fill_hull(evaluate_mask, m_evaluate_hull, scale, offset);
+
+        //只统计两者外接矩形的并,其余像素均为0
+        auto rect = get_hull_rect(m_evaluate_hull, scale, offset, evaluate_mask.size());
+        auto standard_rect = get_standard_rect(level);
+        auto union_rect = rect.area() == 0 ? standard_rect : (standard_rect.area() == 0 ? rect : (rect | standard_rect));
+        std::uint64_t intersection_count = 0;
+        std::uint64_t union_count = 0;
+        for (auto y = union_rect.y; y < union_rect.y + union_rect.height; ++y)
+        {
+            auto standard_row = standard_mask.ptr<std::uint8_t>(y);
+            auto evaluate_row = evaluate_mask.ptr<std::uint8_t>(y);
+            for (auto x = union_rect.x; x < union_rect.x + union_rect.width; ++x)
+            {
+                auto is_standard = standard_row[x] != 0;
+                auto is_evaluate = evaluate_row[x] != 0;
+                intersection_count += is_standard && is_evaluate;
+                union_count += is_standard || is_evaluate;
+            }
+        }
+        //只清除填充过的区域
+        if (rect.area() != 0)
+        {
+            evaluate_mask(rect).setTo(cv::Scalar(0));
+        }
+        return union_count == 0 ? 0.0 : (double)intersection_count / union_count;
+    }
+    std::vector<AlignmentCandidate> select_top(std::vector<AlignmentCandidate> &candidates, int level, int &evaluated_count)
+    {
+        for (auto &candidate : candidates)
+        {
+            candidate.iou = get_iou(candidate, level);
+        }
+        evaluated_count += (int)candidates.size();
+        auto top_count = std::min<std::size_t>(std::max(1, m_options.top_count), candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + top_count, candidates.end(), [](auto &x, auto &y)
+                          { return x.iou > y.iou; });
+        return std::vector<AlignmentCandidate>(candidates.begin(), candidates.begin() + top_count);
+    }
+    //变换后凸包的外接矩形,多留1像素以包含填充的边界
+    static cv::Rect get_hull_rect(const std::vector<cv::Point> &hull, double scale, cv::Point2d offset, cv::Size size)
+    {
+        if (hull.empty())
+        {
+            return cv::Rect();
+        }
+        auto min_x = hull[0].x * scale + offset.x, max_x = min_x;
+        auto min_y = hull[0].y * scale + offset.y, max_y = min_y;
+        for (auto &point : hull)
+        {
+            min_x = std::min(min_x, point.x * scale + offset.x);
+            max_x = std::max(max_x, point.x * scale + offset.x);
+            min_y = std::min(min_y, point.y * scale + offset.y);
+            max_y = std::max(max_y, point.y * scale + offset.y);
+        }
+        auto left = std::max(0, (int)std::floor(min_x) - 1);
+        auto top = std::max(0, (int)std::floor(min_y) - 1);
+        auto right = std::min(size.width, (int)std::ceil(max_x) + 2);
+        auto bottom = std::min(size.height, (int)std::ceil(max_y) + 2);
+        if (right <= left || bottom <= top)
+        {
+            return cv::Rect();
+        }
+        return cv::Rect(left, top, right - left, bottom - top);
+    }
+    cv::Rect get_standard_rect(int level)
+    {
+        if (m_standard_rects.empty())
+        {
+            for (auto &mask : m_standard_masks)
+            {
+                std::vector<cv::Point> points;
+                cv::findNonZero(mask, points);
+                m_standard_rects.push_back(points.empty() ? cv::Rect() : cv::boundingRect(points));
+            }
+        }
+        return m_standard_rects[level];
+    }
+    std::vector<cv::Point> m_evaluate_hull;
+    cv::Point2d m_fixed_center;
+    double m_base_scale;
+    cv::Point2d m_base_offset;
+    AlignmentSearchOptions m_options;
+    cv::Size m_extend_size;
+    std::vector<cv::Mat> m_standard_masks;
+    std::vector<cv::Mat> m_evaluate_masks;
+    std::vector<cv::Rect> m_standard_rects;
+};
+#endif
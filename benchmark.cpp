@@ -0,0 +1,205 @@
+//评测各接口的基准测试,合成字覆盖不同笔画数、结构类型与点密度
+//每个用例输出一行json,便于在版本之间比较
+//用法: benchmark <config_file> [min_time_ms]
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include "manager.h"
+#include "synthetic.h"
+
+//访问Manager中已准备好的字,单独测试各层级的评分
+class BenchmarkManager : public Manager
+{
+public:
+    using Manager::Manager;
+    Character &get_standard_character() { return m_standard_character; }
+    Character &get_evaluate_character() { return m_evaluate_character; }
+    std::vector<Segment> &get_evaluate_segments() { return m_evaluate_segments; }
+    Config &get_config() { return m_config; }
+};
+
+/**
+ * @brief 至少运行min_time_ms毫秒,输出每次调用的平均值与分位数
+ *
+ */
+template <typename Func>
+void run_benchmark(const char *name, const SyntheticOptions &options, int min_time_ms, Func func)
+{
+    auto histogram = std::make_unique<LatencyHistogram>();
+    func();
+    auto begin = std::chrono::steady_clock::now();
+    auto end = begin + std::chrono::milliseconds(min_time_ms);
+    auto iterations = 0;
+    for (auto now = begin; now < end || iterations < 3;)
+    {
+        func();
+        auto next = std::chrono::steady_clock::now();
+        histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(next - now).count());
+        now = next;
+        ++iterations;
+    }
+    HistogramSnapshot snapshot;
+    snapshot.merge(*histogram);
+    std::printf(
+        "{\"name\":\"%s\",\"stroke_count\":%d,\"layout\":\"%s\",\"points_per_stroke\":%d,"
+        "\"iterations\":%d,\"mean_ns\":%.0f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}\n",
+        name, options.stroke_count, options.layout.c_str(), options.points_per_stroke,
+        iterations, snapshot.mean(),
+        (unsigned long long)snapshot.percentile(0.5),
+        (unsigned long long)snapshot.percentile(0.99),
+        (unsigned long long)snapshot.max);
+    std::fflush(stdout);
+}
+
+void run_case(const std::string &config_line, SyntheticOptions options, int min_time_ms)
+{
+    auto request = make_synthetic_request(options);
+    request.config_line = config_line;
+    BenchmarkManager manager{Config()};
+    manager.init();
+    manager.parse_config(config_line);
+    manager.prepare(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array);
+    auto config = manager.get_config();
+    auto standard_strokes = manager.get_standard_character().m_strokes;
+    auto evaluate_strokes = manager.get_evaluate_character().m_strokes;
+    auto standard_structions = manager.get_standard_character().m_structions;
+    auto evaluate_structions = manager.get_evaluate_character().m_structions;
+    auto standard_character = manager.get_standard_character();
+    auto evaluate_character = manager.get_evaluate_character();
+    auto segments = manager.get_evaluate_segments();
+
+    run_benchmark("load_from_content", options, min_time_ms, [&]()
+                  { manager.load_from_content(request.evaluate_lines, config); });
+    run_benchmark("map_strokes", options, min_time_ms, [&]()
+                  { manager.map_strokes(request.standard_lines, request.evaluate_lines, request.stroke_info_array); });
+    run_benchmark("get_stroke_map", options, min_time_ms, [&]()
+                  {
+                      Character character;
+                      character.set_manager(&manager);
+                      manager.get_stroke_map(character, segments, request.char_info, request.struction_info_array, request.stroke_info_array, false);
+                  });
+
+    //parse_to_old的输入由各层级评分结果拼成,与score_detail一致
+    std::vector<std::unordered_map<std::string, double>> stroke_scores, stroke_full_scores;
+    std::vector<std::unordered_map<std::string, std::string>> stroke_comments;
+    std::vector<std::unordered_map<std::string, std::vector<std::string>>> stroke_sounds;
+    std::vector<std::unordered_map<std::string, int>> stroke_values;
+    auto stroke_index = 0;
+    run_benchmark("score_stroke", options, min_time_ms, [&]()
+                  {
+                      auto i = stroke_index++ % standard_strokes.size();
+                      manager.score(standard_strokes[i], evaluate_strokes[i], config);
+                  });
+    for (auto i = 0; i < standard_strokes.size(); ++i)
+    {
+        auto [deduction, scores, comments, values, full_scores, sounds] = manager.score(standard_strokes[i], evaluate_strokes[i], config);
+        stroke_scores.push_back(scores);
+        stroke_comments.push_back(comments);
+        stroke_sounds.push_back(sounds);
+        stroke_values.push_back(values);
+        stroke_full_scores.push_back(full_scores);
+    }
+
+    std::vector<std::unordered_map<std::string, double>> struction_scores, struction_full_scores;
+    std::unordered_map<std::string, std::string> struction_comments;
+    std::unordered_map<std::string, std::vector<std::string>> struction_sounds;
+    std::unordered_map<std::string, int> struction_values;
+    std::vector<int> struction_angle_result_array;
+    std::vector<double> struction_angle_value_array;
+    if (!standard_structions.empty() && standard_structions.size() == evaluate_structions.size())
+    {
+        auto struction_index = 0;
+        run_benchmark("score_struction", options, min_time_ms, [&]()
+                      {
+                          auto i = struction_index++ % standard_structions.size();
+                          manager.score(standard_structions[i], evaluate_structions[i], config);
+                      });
+        for (auto i = 0; i < standard_structions.size(); ++i)
+        {
+            auto [deduction, scores, comments, values, full_scores, double_values, sounds] = manager.score(standard_structions[i], evaluate_structions[i], config);
+            struction_scores.push_back(scores);
+            struction_full_scores.push_back(full_scores);
+            struction_angle_result_array.push_back(values["struction_angle"]);
+            struction_angle_value_array.push_back(double_values["struction_angle"]);
+            if (i == 0)
+            {
+                struction_comments = comments;
+                struction_sounds = sounds;
+                struction_values = values;
+            }
+        }
+    }
+
+    run_benchmark("score_character", options, min_time_ms, [&]()
+                  { manager.score(standard_character, evaluate_character, struction_angle_result_array, struction_angle_value_array, config); });
+    auto [character_deduction, character_scores, character_comments, character_values, character_full_scores, character_sounds] =
+        manager.score(standard_character, evaluate_character, struction_angle_result_array, struction_angle_value_array, config);
+
+    run_benchmark("score_base", options, min_time_ms, [&]()
+                  { manager.score_base(request.is_character_right, config, request.stroke_info_array, request.standard_lines, request.evaluate_lines); });
+    auto [base_deduction, base_scores, base_comments, base_values, base_full_scores, base_sounds] =
+        manager.score_base(request.is_character_right, config, request.stroke_info_array, request.standard_lines, request.evaluate_lines);
+
+    run_benchmark("parse_to_old", options, min_time_ms, [&]()
+                  {
+                      manager.parse_to_old(
+                          100 * (1 - character_deduction - base_deduction), request.is_character_right,
+                          base_scores, base_comments, base_sounds, base_values, base_full_scores,
+                          character_scores, character_comments, character_sounds, character_values, character_full_scores,
+                          struction_scores, struction_comments, struction_sounds, struction_values, struction_full_scores,
+                          stroke_scores, stroke_comments, stroke_sounds, stroke_values, stroke_full_scores);
+                  });
+
+    run_benchmark("score", options, min_time_ms, [&]()
+                  { manager.score(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.config_line, request.is_character_right); });
+    run_benchmark("score_holistic", options, min_time_ms, [&]()
+                  { manager.score(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.config_line); });
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <config_file> [min_time_ms]\n", argv[0]);
+        return 1;
+    }
+    std::ifstream config_file(argv[1]);
+    std::stringstream config_stream;
+    config_stream << config_file.rdbuf();
+    auto config_line = config_stream.str();
+    auto min_time_ms = argc > 2 ? std::atoi(argv[2]) : 50;
+
+    std::vector<int> stroke_count_array{1, 2, 3, 5, 10, 20, 30};
+    std::vector<std::string> layout_array{" ", "⿰", "⿱", "⿲", "⿳"};
+    std::vector<int> points_per_stroke_array{8, 64, 512};
+    for (auto layout : layout_array)
+    {
+        for (auto stroke_count : stroke_count_array)
+        {
+            if (stroke_count < get_layout_struction_count(layout))
+            {
+                continue;
+            }
+            for (auto points_per_stroke : points_per_stroke_array)
+            {
+                SyntheticOptions options;
+                options.stroke_count = stroke_count;
+                options.layout = layout;
+                options.points_per_stroke = points_per_stroke;
+                options.seed = stroke_count * 1000 + points_per_stroke;
+                try
+                {
+                    run_case(config_line, options, min_time_ms);
+                }
+                catch (const std::exception &e)
+                {
+                    std::printf("{\"name\":\"error\",\"stroke_count\":%d,\"layout\":\"%s\",\"points_per_stroke\":%d,\"what\":\"%s\"}\n",
+                                stroke_count, layout.c_str(), points_per_stroke, e.what());
+                }
+            }
+        }
+    }
+    return 0;
+}
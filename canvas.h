@@ -0,0 +1,152 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+//编译期特化的画布尺寸,可在编译时通过-DCANVAS_SIZE_SPECIALIZATIONS=128,256,512修改
+#ifndef CANVAS_SIZE_SPECIALIZATIONS
+#define CANVAS_SIZE_SPECIALIZATIONS 128, 256
+#endif
+
+/**
+ * @brief 画布尺寸,Width/Height非0时尺寸为编译期常量
+ *
+ * 各方法返回std::integral_constant,参与运算时隐式转为int,
+ * 编译器可把除法与循环边界当作常量处理
+ */
+template <int Width, int Height>
+class CanvasSize
+{
+public:
+    CanvasSize(int = Width, int = Height) {}
+    std::integral_constant<int, Width> width() const { return {}; }
+    std::integral_constant<int, Height> height() const { return {}; }
+    std::integral_constant<int, Width / 2> half_width() const { return {}; }
+    std::integral_constant<int, Height / 2> half_height() const { return {}; }
+    //凸包对齐用的2倍画布
+    std::integral_constant<int, 2 * Width> extend_width() const { return {}; }
+    std::integral_constant<int, 2 * Height> extend_height() const { return {}; }
+    std::integral_constant<std::size_t, (std::size_t)4 * Width * Height> extend_area() const { return {}; }
+};
+
+/**
+ * @brief 运行期画布尺寸,配置里的尺寸不在特化列表中时使用
+ *
+ */
+template <>
+class CanvasSize<0, 0>
+{
+public:
+    CanvasSize(int width, int height) : m_width(width), m_height(height) {}
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int half_width() const { return m_width / 2; }
+    int half_height() const { return m_height / 2; }
+    int extend_width() const { return 2 * m_width; }
+    int extend_height() const { return 2 * m_height; }
+    std::size_t extend_area() const { return (std::size_t)4 * m_width * m_height; }
+
+protected:
+    int m_width;
+    int m_height;
+};
+using DynamicCanvasSize = CanvasSize<0, 0>;
+
+//正方形画布边长列表
+template <int... Sizes>
+class CanvasSizeList
+{
+};
+using CanvasSizeSpecializations = CanvasSizeList<CANVAS_SIZE_SPECIALIZATIONS>;
+
+/**
+ * @brief 按运行期的宽高选择特化的画布尺寸调用func,都不匹配时使用DynamicCanvasSize
+ *
+ * @param func 泛型可调用对象,参数为CanvasSize,各特化版本返回类型需一致
+ */
+template <typename Func>
+auto dispatch_canvas_size(CanvasSizeList<>, int width, int height, Func &&func)
+{
+    return func(DynamicCanvasSize(width, height));
+}
+template <int Size, int... Rest, typename Func>
+auto dispatch_canvas_size(CanvasSizeList<Size, Rest...>, int width, int height, Func &&func)
+{
+    if (width == Size && height == Size)
+    {
+        return func(CanvasSize<Size, Size>(width, height));
+    }
+    return dispatch_canvas_size(CanvasSizeList<Rest...>(), width, height, std::forward<Func>(func));
+}
+
+//非零像素的凸包顶点,像素坐标
+inline std::vector<cv::Point> get_hull_points(const cv::Mat &mat)
+{
+    std::vector<cv::Point> points;
+    cv::findNonZero(mat, points);
+    std::vector<cv::Point> hull;
+    if (!points.empty())
+    {
+        cv::convexHull(points, hull);
+    }
+    return hull;
+}
+
+//fill_hull顶点坐标保留的二进制小数位数
+constexpr int HULL_FILL_SHIFT = 8;
+
+/**
+ * @brief 把凸包顶点按 p * scale + offset 变换后填充到canvas
+ *
+ * 只变换顶点再光栅化,代替对整张画布做warpAffine插值,边缘没有插值产生的灰度
+ */
+inline void fill_hull(cv::Mat &canvas, const std::vector<cv::Point> &hull, double scale, cv::Point2d offset, double value = 255)
+{
+    if (hull.empty())
+    {
+        return;
+    }
+    const double factor = 1 << HULL_FILL_SHIFT;
+    std::vector<cv::Point> points;
+    points.reserve(hull.size());
+    for (auto &point : hull)
+    {
+        points.push_back(cv::Point(
+            (int)std::lround((point.x * scale + offset.x) * factor),
+            (int)std::lround((point.y * scale + offset.y) * factor)));
+    }
+    cv::fillConvexPoly(canvas, points, cv::Scalar(value), cv::LINE_8, HULL_FILL_SHIFT);
+}
+
+/**
+ * @brief 两张2倍画布上二值图的交集与并集像素和,与cv::sum(mat1 & mat2)[0], cv::sum(mat1 | mat2)[0]一致
+ *
+ * 单通道8位连续内存时一次遍历完成,不生成中间图
+ */
+template <typename CanvasSizeT>
+std::tuple<double, double> get_overlap_sum(const cv::Mat &mat1, const cv::Mat &mat2, CanvasSizeT size)
+{
+    std::size_t total = size.extend_area();
+    if (mat1.type() != CV_8UC1 || mat2.type() != CV_8UC1 ||
+        !mat1.isContinuous() || !mat2.isContinuous() ||
+        mat1.total() != total || mat2.total() != total)
+    {
+        return {cv::sum(mat1 & mat2)[0], cv::sum(mat1 | mat2)[0]};
+    }
+    auto data1 = mat1.ptr<std::uint8_t>();
+    auto data2 = mat2.ptr<std::uint8_t>();
+    std::uint64_t intersection_sum = 0;
+    std::uint64_t union_sum = 0;
+    for (std::size_t i = 0; i < size.extend_area(); ++i)
+    {
+        intersection_sum += data1[i] & data2[i];
+        union_sum += data1[i] | data2[i];
+    }
+    return {(double)intersection_sum, (double)union_sum};
+}
+#endif
@@ -0,0 +1,148 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "configor/json.hpp"
+#include "corpus.h"
+#include "profiler.h"
+#include "request.h"
+#include "resample.h"
+
+class SlowRequestLogOptions
+{
+public:
+    std::string directory = ".";
+    std::string prefix = "slow_request";
+    double threshold_ms = 1000.0; //超过该耗时的请求被记录
+    int max_file_count = 16;      //环形覆盖的文件个数
+    int sample_interval = 1;      //每sample_interval个请求监测一个,其余请求不计时
+    int min_interval_ms = 1000;   //两次记录的最小间隔,避免整体变慢时频繁写盘
+    bool is_with_config = true;   //是否写入config_line,不写时回放需用--config指定
+};
+
+/**
+ * @brief 慢请求记录:耗时超过阈值的请求连同各阶段耗时与点数写入环形的若干文件
+ *
+ * 每个文件是只有一条记录的语料,replay可直接读取;capture字段为附加信息,回放时忽略
+ * 多个Manager可共用一个SlowRequestLog,文件序号全局递增
+ */
+class SlowRequestLog
+{
+public:
+    SlowRequestLog(SlowRequestLogOptions options) : m_options(options)
+    {
+    }
+    //本次请求是否需要监测
+    bool should_sample()
+    {
+        if (m_options.sample_interval <= 1)
+        {
+            return true;
+        }
+        return m_request_count.fetch_add(1, std::memory_order_relaxed) % m_options.sample_interval == 0;
+    }
+    bool is_slow(std::uint64_t nanoseconds) const
+    {
+        return nanoseconds >= m_options.threshold_ms * 1e6;
+    }
+    /**
+     * @brief 写入一条慢请求,距上次记录不足min_interval_ms时丢弃
+     *
+     * @param entry 接口名,score, score_holistic, evaluate
+     * @param error 评测抛出异常时的what(),正常时为空
+     * @return 写入的文件路径,未写入时为空
+     */
+    std::string capture(
+        const char *entry,
+        const ScoreRequest &request,
+        std::uint64_t latency_ns,
+        const RequestStageTimes &times,
+        const std::vector<SegmentPointCount> &standard_point_counts,
+        const std::vector<SegmentPointCount> &evaluate_point_counts,
+        const std::string &error)
+    {
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        auto last = m_last_capture_ms.load(std::memory_order_relaxed);
+        if (last != 0 && now - last < m_options.min_interval_ms)
+        {
+            return "";
+        }
+        if (!m_last_capture_ms.compare_exchange_strong(last, now, std::memory_order_relaxed))
+        {
+            return "";
+        }
+        auto index = m_capture_count.fetch_add(1, std::memory_order_relaxed);
+
+        auto res = request_to_json(request, m_options.is_with_config);
+        configor::json capture;
+        capture["entry"] = entry;
+        capture["latency_ns"] = (long long)latency_ns;
+        capture["error"] = error;
+        capture["unix_time_ms"] = (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        configor::json stage_ns;
+        configor::json stage_calls;
+        for (auto i = 0; i < STAGE_COUNT; ++i)
+        {
+            stage_ns[get_stage_name((Stage)i)] = (long long)times.nanoseconds[i];
+            stage_calls[get_stage_name((Stage)i)] = times.counts[i];
+        }
+        capture["stage_ns"] = stage_ns;
+        capture["stage_calls"] = stage_calls;
+        capture["standard_point_counts"] = point_counts_to_json(standard_point_counts);
+        capture["evaluate_point_counts"] = point_counts_to_json(evaluate_point_counts);
+        res["capture"] = capture;
+
+        //先写临时文件再改名,读取方不会看到写了一半的文件
+        auto path = m_options.directory + "/" + m_options.prefix + "_" + std::to_string(index % std::max(1, m_options.max_file_count)) + ".jsonl";
+        auto temp_path = path + ".tmp";
+        {
+            std::ofstream file(temp_path);
+            if (!file.is_open())
+            {
+                return "";
+            }
+            file << res.dump() << '\n';
+        }
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp_path.c_str());
+            return "";
+        }
+        return path;
+    }
+    //已写入的记录数
+    int get_capture_count() const
+    {
+        return m_capture_count.load(std::memory_order_relaxed);
+    }
+    const SlowRequestLogOptions &get_options() const
+    {
+        return m_options;
+    }
+
+protected:
+    static std::vector<configor::json> point_counts_to_json(const std::vector<SegmentPointCount> &point_counts)
+    {
+        std::vector<configor::json> res;
+        for (auto &point_count : point_counts)
+        {
+            configor::json item;
+            item["index"] = point_count.index;
+            item["raw_count"] = point_count.raw_count;
+            item["resampled_count"] = point_count.resampled_count;
+            res.push_back(item);
+        }
+        return res;
+    }
+    SlowRequestLogOptions m_options;
+    std::atomic<std::uint64_t> m_request_count{0};
+    std::atomic<long long> m_last_capture_ms{0};
+    std::atomic<int> m_capture_count{0};
+};
+#endif
@@ -0,0 +1,266 @@
+//正确性检查:快速版本与原实现的结果比较,与计时的benchmark分开
+//有不一致时输出各项的json并以非0退出,可在提交前或CI中运行
+//用法: check <config_file>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include "generator.h"
+#include "manager.h"
+#include "synthetic.h"
+
+//在mat中把(x, y)起w×h的像素置为255,超出边界的部分忽略
+void fill_pixels(cv::Mat &mat, int x, int y, int w, int h)
+{
+    for (auto row = std::max(0, y); row < std::min(mat.rows, y + h); ++row)
+    {
+        for (auto col = std::max(0, x); col < std::min(mat.cols, x + w); ++col)
+        {
+            mat.ptr<uchar>(row)[col] = 255;
+        }
+    }
+}
+
+/**
+ * @brief 比较is_stroke_valid_by_count与is_stroke_valid,覆盖多个连通域与单像素宽的细线
+ *
+ * 两者应完全一致,返回不一致的个数
+ */
+int check_stroke_valid()
+{
+    Manager manager{Config()};
+    std::vector<cv::Mat> masks;
+    //masks中的Mat与返回值共用像素
+    auto make_mask = [&]()
+    {
+        cv::Mat mask = cv::Mat::zeros(32, 32, CV_8UC1);
+        masks.push_back(mask);
+        return mask;
+    };
+    //两个2×2的块:各自面积1,合计2
+    auto mask = make_mask();
+    fill_pixels(mask, 2, 2, 2, 2);
+    fill_pixels(mask, 10, 10, 2, 2);
+    //三个2×2的块
+    mask = make_mask();
+    fill_pixels(mask, 2, 2, 2, 2);
+    fill_pixels(mask, 10, 10, 2, 2);
+    fill_pixels(mask, 20, 20, 2, 2);
+    //单像素宽的横线、竖线与斜线
+    mask = make_mask();
+    fill_pixels(mask, 1, 5, 30, 1);
+    mask = make_mask();
+    fill_pixels(mask, 5, 1, 1, 30);
+    mask = make_mask();
+    for (auto i = 0; i < 30; ++i)
+    {
+        fill_pixels(mask, i, i, 1, 1);
+    }
+    //三像素宽的横线
+    mask = make_mask();
+    fill_pixels(mask, 1, 5, 30, 3);
+    //随机的小块与细线
+    std::mt19937 random(0);
+    for (auto i = 0; i < 512; ++i)
+    {
+        mask = make_mask();
+        auto count = 1 + random() % 4;
+        for (auto k = 0; k < count; ++k)
+        {
+            auto x = (int)(random() % 30);
+            auto y = (int)(random() % 30);
+            if (random() % 2 == 0)
+            {
+                fill_pixels(mask, x, y, 1 + random() % 3, 1 + random() % 3);
+            }
+            else
+            {
+                auto length = 2 + random() % 12;
+                auto slope = (int)(random() % 3);
+                for (auto j = 0; j < length; ++j)
+                {
+                    fill_pixels(mask, x + j, y + slope * j / 2, 1, 1);
+                }
+            }
+        }
+    }
+    auto mismatch_count = 0;
+    for (auto &mat : masks)
+    {
+        if (manager.is_stroke_valid_by_count(mat) != manager.is_stroke_valid(mat.clone()))
+        {
+            ++mismatch_count;
+        }
+    }
+    std::printf("{\"name\":\"stroke_valid_by_count\",\"case_count\":%d,\"mismatch_count\":%d}\n", (int)masks.size(), mismatch_count);
+    std::fflush(stdout);
+    return mismatch_count;
+}
+
+/**
+ * @brief 统计is_stroke_valid_by_length与is_stroke_valid不一致的个数,只输出不作为失败
+ *
+ * by_length是估计,与按轮廓求面积的结果本就不同(差异见Manager::is_stroke_valid_by_length),
+ * 折线按线宽画成方块的并集后比较,输出两个方向的不一致数,用于在修改阈值前评估影响
+ */
+void report_stroke_valid_by_length()
+{
+    Manager manager{Config()};
+    std::mt19937 random(1);
+    auto case_count = 0;
+    auto length_only_count = 0;  //by_length为true而is_stroke_valid为false
+    auto contour_only_count = 0; //by_length为false而is_stroke_valid为true
+    for (auto i = 0; i < 512; ++i)
+    {
+        auto stroke_width = 1 + (int)(random() % 3);
+        std::vector<cv::Point2i> points;
+        auto count = 1 + random() % 6;
+        for (auto k = 0; k < count; ++k)
+        {
+            if (points.empty() || random() % 4 != 0)
+            {
+                points.push_back(cv::Point2i(4 + random() % 24, 4 + random() % 24));
+            }
+            else
+            {
+                points.push_back(points.back());
+            }
+        }
+        cv::Mat mat = cv::Mat::zeros(32, 32, CV_8UC1);
+        for (auto k = 0; k < points.size(); ++k)
+        {
+            auto begin = k == 0 ? points[k] : points[k - 1];
+            auto end = points[k];
+            auto steps = std::max(std::abs(end.x - begin.x), std::abs(end.y - begin.y));
+            for (auto j = 0; j <= steps; ++j)
+            {
+                auto x = steps == 0 ? begin.x : begin.x + (end.x - begin.x) * j / steps;
+                auto y = steps == 0 ? begin.y : begin.y + (end.y - begin.y) * j / steps;
+                fill_pixels(mat, x - stroke_width / 2, y - stroke_width / 2, stroke_width, stroke_width);
+            }
+        }
+        auto is_valid_by_length = manager.is_stroke_valid_by_length(points, stroke_width);
+        auto is_valid = manager.is_stroke_valid(mat);
+        ++case_count;
+        if (is_valid_by_length && !is_valid)
+        {
+            ++length_only_count;
+        }
+        else if (!is_valid_by_length && is_valid)
+        {
+            ++contour_only_count;
+        }
+    }
+    std::printf("{\"name\":\"stroke_valid_by_length\",\"case_count\":%d,\"length_only_count\":%d,\"contour_only_count\":%d}\n",
+                case_count, length_only_count, contour_only_count);
+    std::fflush(stdout);
+}
+
+/**
+ * @brief 由生成器产生含漏写与多写笔画的测试字,检查部件序号都在未跳过的笔画之内且评测不抛出异常
+ *
+ * 返回序号越界与抛出异常的个数之和
+ */
+int run_generated_case(const std::string &config_line, SyntheticOptions options, int case_count)
+{
+    auto reference = make_synthetic_request(options);
+    reference.config_line = config_line;
+    GeneratorOptions generator_options;
+    generator_options.missing_stroke_rate = 0.2;
+    generator_options.extra_stroke_rate = 0.2;
+    HandwritingGenerator generator(reference, generator_options, options.seed);
+    Manager manager{Config()};
+    manager.init();
+    auto skip_count = 0;
+    auto invalid_count = 0;
+    auto error_count = 0;
+    std::string first_error;
+    for (auto i = 0; i < case_count; ++i)
+    {
+        auto request = generator.generate(i);
+        auto stroke_count = 0;
+        for (auto &stroke_info : request.stroke_info_array)
+        {
+            stroke_info.is_skip ? ++skip_count : ++stroke_count;
+        }
+        auto is_valid = true;
+        for (auto struction_index : request.char_info.struction_index_array)
+        {
+            if (struction_index < 0 || struction_index >= request.struction_info_array.size())
+            {
+                is_valid = false;
+                continue;
+            }
+            for (auto stroke_index : request.struction_info_array[struction_index].stroke_index_array)
+            {
+                is_valid = is_valid && stroke_index >= 0 && stroke_index < stroke_count;
+            }
+        }
+        if (!is_valid)
+        {
+            ++invalid_count;
+            continue;
+        }
+        try
+        {
+            manager.score(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.config_line, request.is_character_right);
+        }
+        catch (const std::exception &e)
+        {
+            if (error_count++ == 0)
+            {
+                first_error = e.what();
+            }
+        }
+    }
+    configor::json res;
+    res["name"] = "generated";
+    res["stroke_count"] = options.stroke_count;
+    res["layout"] = options.layout;
+    res["case_count"] = case_count;
+    res["skip_count"] = skip_count;
+    res["invalid_count"] = invalid_count;
+    res["error_count"] = error_count;
+    res["first_error"] = first_error;
+    std::printf("%s\n", res.dump().c_str());
+    std::fflush(stdout);
+    return invalid_count + error_count;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <config_file>\n", argv[0]);
+        return 1;
+    }
+    std::ifstream config_file(argv[1]);
+    std::stringstream config_stream;
+    config_stream << config_file.rdbuf();
+    auto config_line = config_stream.str();
+
+    auto failure_count = 0;
+    failure_count += check_stroke_valid() > 0;
+    report_stroke_valid_by_length();
+
+    std::vector<int> stroke_count_array{1, 2, 3, 5, 10, 20, 30};
+    std::vector<std::string> layout_array{" ", "⿰", "⿱", "⿲", "⿳"};
+    for (auto layout : layout_array)
+    {
+        for (auto stroke_count : stroke_count_array)
+        {
+            if (stroke_count < get_layout_struction_count(layout))
+            {
+                continue;
+            }
+            SyntheticOptions options;
+            options.stroke_count = stroke_count;
+            options.layout = layout;
+            options.seed = stroke_count;
+            failure_count += run_generated_case(config_line, options, 32) > 0;
+        }
+    }
+    return failure_count > 0 ? 1 : 0;
+}
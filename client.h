@@ -0,0 +1,187 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "protocol.h"
+#include "shm_ring.h"
+
+/**
+ * @brief 评测服务的客户端,一个连接不加锁,多线程使用时每个线程一个
+ *
+ * send与receive分开可以在一个连接上同时发出多个请求,响应按id对应
+ */
+class ScoringClient
+{
+public:
+    ScoringClient(const std::string &socket_path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path))
+        {
+            throw std::runtime_error("socket path too long: " + socket_path);
+        }
+        std::strcpy(address.sun_path, socket_path.c_str());
+        m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (m_fd < 0 || ::connect(m_fd, (sockaddr *)&address, sizeof(address)) != 0)
+        {
+            auto message = std::string("cannot connect to ") + socket_path + ": " + std::strerror(errno);
+            if (m_fd >= 0)
+            {
+                ::close(m_fd);
+            }
+            throw std::runtime_error(message);
+        }
+    }
+    ~ScoringClient()
+    {
+        ::close(m_fd);
+    }
+    ScoringClient(const ScoringClient &) = delete;
+    ScoringClient &operator=(const ScoringClient &) = delete;
+
+    void send(const ScoreEnvelope &envelope)
+    {
+        if (!write_frame(m_fd, dump_score_envelope(envelope)))
+        {
+            throw std::runtime_error("connection closed while sending");
+        }
+    }
+    ScoreResponse receive()
+    {
+        std::string payload;
+        if (!read_frame(m_fd, payload))
+        {
+            throw std::runtime_error("connection closed while receiving");
+        }
+        return parse_score_response(payload);
+    }
+    //请求id的起点,新连接上没有其他请求的响应
+    std::uint32_t get_id_base() const
+    {
+        return 0;
+    }
+    //发送一个请求并等待其响应,评测出错时抛出异常;连接上不能有未收完的send
+    EvaluateResult evaluate(const ScoreRequest &request, int flags = EVALUATE_DETAIL | EVALUATE_HOLISTIC, ResultFormat format = ResultFormat::json)
+    {
+        ScoreEnvelope envelope;
+        envelope.id = ++m_next_id;
+        envelope.flags = flags;
+        envelope.format = format;
+        envelope.request = request;
+        send(envelope);
+        auto response = receive();
+        if (!response.error.empty())
+        {
+            throw std::runtime_error(response.error);
+        }
+        return response.result;
+    }
+
+protected:
+    int m_fd = -1;
+    std::uint32_t m_next_id = 0;
+};
+
+/**
+ * @brief 共享内存通道的客户端,接口与ScoringClient相同,供同机前端使用
+ *
+ * 请求直接写入请求环,响应在响应环内原地解析;一个通道同时只能被一个客户端打开
+ */
+class ShmScoringClient
+{
+public:
+    //timeout_ms为等待环空间或响应的最长时间,超时抛出异常
+    ShmScoringClient(const std::string &name, int timeout_ms = 30000) : m_channel(ShmChannel::open(name)), m_timeout_ms(timeout_ms)
+    {
+        m_next_id = get_id_base();
+    }
+
+    void send(const ScoreEnvelope &envelope)
+    {
+        if (!write_shm_envelope(m_channel->get_request_ring(), envelope, get_deadline()))
+        {
+            throw std::runtime_error("timeout while sending to " + m_channel->get_name());
+        }
+    }
+    ScoreResponse receive()
+    {
+        auto &ring = m_channel->get_response_ring();
+        auto deadline = get_deadline();
+        ShmBackoff backoff;
+        std::size_t size;
+        const char *data;
+        while (true)
+        {
+            try
+            {
+                data = ring.peek(size);
+            }
+            catch (...)
+            {
+                ring.drain();
+                throw;
+            }
+            if (data != nullptr)
+            {
+                break;
+            }
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                throw std::runtime_error("timeout while receiving from " + m_channel->get_name());
+            }
+            backoff.wait();
+        }
+        try
+        {
+            auto response = parse_score_response(data, size);
+            ring.release();
+            return response;
+        }
+        catch (...)
+        {
+            ring.release();
+            throw;
+        }
+    }
+    //请求id的起点,由本次占用通道的序号决定,接管通道时与上一个前端的id不同
+    std::uint32_t get_id_base() const
+    {
+        return m_channel->get_id_base();
+    }
+    //发送一个请求并等待其响应,评测出错时抛出异常;通道上不能有未收完的send
+    //接管通道时上一个前端留下的请求的响应id不同,跳过
+    EvaluateResult evaluate(const ScoreRequest &request, int flags = EVALUATE_DETAIL | EVALUATE_HOLISTIC, ResultFormat format = ResultFormat::binary)
+    {
+        ScoreEnvelope envelope;
+        envelope.id = ++m_next_id;
+        envelope.flags = flags;
+        envelope.format = format;
+        envelope.request = request;
+        send(envelope);
+        auto response = receive();
+        while (response.id != envelope.id)
+        {
+            response = receive();
+        }
+        if (!response.error.empty())
+        {
+            throw std::runtime_error(response.error);
+        }
+        return response.result;
+    }
+
+protected:
+    std::chrono::steady_clock::time_point get_deadline() const
+    {
+        return std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout_ms);
+    }
+    std::unique_ptr<ShmChannel> m_channel;
+    int m_timeout_ms;
+    std::uint32_t m_next_id = 0;
+};
+#endif
@@ -0,0 +1,272 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "configor/json.hpp"
+#include "request.h"
+
+/**
+ * @brief 评测语料中的一条记录:一次请求的全部输入,以及可选的基准输出
+ *
+ * 语料为jsonl,每行一条记录,字段名与ScoreRequest一致,基准输出放在golden中:
+ * {"standard_lines":[...],"evaluate_lines":[...],"char_info":{...},"struction_info_array":[...],
+ *  "stroke_info_array":[...],"config_line":"...","is_character_right":true,
+ *  "golden":{"detail":{...},"red_index_array":[...],"holistic_score":0.9,"detail_error":"","holistic_error":""}}
+ * config_line可以省略,由回放工具统一指定
+ */
+class CorpusRecord
+{
+public:
+    ScoreRequest request;
+    bool has_golden = false;
+    configor::json golden_detail;
+    std::vector<int> golden_red_index_array;
+    double golden_holistic_score = 0.0;
+    std::string golden_detail_error;   //评测抛出异常时的what(),正常时为空
+    std::string golden_holistic_error;
+};
+
+inline configor::json stroke_info_to_json(const StrokeInfo &stroke_info)
+{
+    configor::json res;
+    res["name"] = stroke_info.name;
+    res["order"] = stroke_info.order;
+    res["is_valid"] = stroke_info.is_valid;
+    res["is_skip"] = stroke_info.is_skip;
+    res["is_reliable"] = stroke_info.is_reliable;
+    res["segment_index_array"] = stroke_info.segment_index_array;
+    return res;
+}
+
+inline StrokeInfo stroke_info_from_json(configor::json &obj)
+{
+    StrokeInfo stroke_info;
+    stroke_info.name = obj["name"].as_string();
+    stroke_info.order = (int)obj["order"].as_integer();
+    stroke_info.is_valid = obj["is_valid"].as_bool();
+    stroke_info.is_skip = obj["is_skip"].as_bool();
+    stroke_info.is_reliable = obj["is_reliable"].as_bool();
+    for (auto item : obj["segment_index_array"])
+    {
+        stroke_info.segment_index_array.push_back((int)item.as_integer());
+    }
+    return stroke_info;
+}
+
+inline configor::json request_to_json(const ScoreRequest &request, bool is_with_config = true)
+{
+    configor::json res;
+    res["standard_lines"] = request.standard_lines;
+    res["evaluate_lines"] = request.evaluate_lines;
+    configor::json char_info;
+    char_info["name"] = request.char_info.name;
+    char_info["type"] = request.char_info.type;
+    char_info["struction_index_array"] = request.char_info.struction_index_array;
+    char_info["warp_score"] = request.char_info.warp_score;
+    res["char_info"] = char_info;
+    std::vector<configor::json> struction_info_array;
+    for (auto &struction_info : request.struction_info_array)
+    {
+        configor::json item;
+        item["stroke_index_array"] = struction_info.stroke_index_array;
+        struction_info_array.push_back(item);
+    }
+    res["struction_info_array"] = struction_info_array;
+    std::vector<configor::json> stroke_info_array;
+    for (auto &stroke_info : request.stroke_info_array)
+    {
+        stroke_info_array.push_back(stroke_info_to_json(stroke_info));
+    }
+    res["stroke_info_array"] = stroke_info_array;
+    if (is_with_config)
+    {
+        res["config_line"] = request.config_line;
+    }
+    res["is_character_right"] = request.is_character_right;
+    return res;
+}
+
+inline ScoreRequest request_from_json(configor::json &obj)
+{
+    ScoreRequest request;
+    for (auto item : obj["standard_lines"])
+    {
+        request.standard_lines.push_back(item.as_string());
+    }
+    for (auto item : obj["evaluate_lines"])
+    {
+        request.evaluate_lines.push_back(item.as_string());
+    }
+    auto &char_info = obj["char_info"];
+    request.char_info.name = char_info["name"].as_string();
+    request.char_info.type = char_info["type"].as_string();
+    for (auto item : char_info["struction_index_array"])
+    {
+        request.char_info.struction_index_array.push_back((int)item.as_integer());
+    }
+    request.char_info.warp_score = char_info["warp_score"].is_null() ? 0.0 : char_info["warp_score"].as_float();
+    for (auto item : obj["struction_info_array"])
+    {
+        StructionInfo struction_info;
+        for (auto index : item["stroke_index_array"])
+        {
+            struction_info.stroke_index_array.push_back((int)index.as_integer());
+        }
+        request.struction_info_array.push_back(struction_info);
+    }
+    for (auto item : obj["stroke_info_array"])
+    {
+        request.stroke_info_array.push_back(stroke_info_from_json(item));
+    }
+    if (!obj["config_line"].is_null())
+    {
+        request.config_line = obj["config_line"].as_string();
+    }
+    request.is_character_right = obj["is_character_right"].is_null() ? true : obj["is_character_right"].as_bool();
+    return request;
+}
+
+//一条记录序列化为一行,不含换行符
+inline std::string dump_corpus_record(const CorpusRecord &record, bool is_with_config = true)
+{
+    auto res = request_to_json(record.request, is_with_config);
+    if (record.has_golden)
+    {
+        configor::json golden;
+        golden["detail"] = record.golden_detail;
+        golden["red_index_array"] = record.golden_red_index_array;
+        golden["holistic_score"] = record.golden_holistic_score;
+        golden["detail_error"] = record.golden_detail_error;
+        golden["holistic_error"] = record.golden_holistic_error;
+        res["golden"] = golden;
+    }
+    return res.dump();
+}
+
+inline CorpusRecord parse_corpus_record(const std::string &line)
+{
+    auto obj = configor::json::parse(line);
+    CorpusRecord record;
+    record.request = request_from_json(obj);
+    auto &golden = obj["golden"];
+    if (!golden.is_null())
+    {
+        record.has_golden = true;
+        record.golden_detail = golden["detail"];
+        for (auto item : golden["red_index_array"])
+        {
+            record.golden_red_index_array.push_back((int)item.as_integer());
+        }
+        record.golden_holistic_score = golden["holistic_score"].is_null() ? 0.0 : golden["holistic_score"].as_float();
+        record.golden_detail_error = golden["detail_error"].is_null() ? "" : golden["detail_error"].as_string();
+        record.golden_holistic_error = golden["holistic_error"].is_null() ? "" : golden["holistic_error"].as_string();
+    }
+    return record;
+}
+
+/**
+ * @brief 逐行读取语料,多个线程可同时调用next,每行只解析一次
+ *
+ * 只在取行时加锁,解析在调用线程中完成,语料不会整体读入内存
+ */
+class CorpusReader
+{
+public:
+    CorpusReader(const std::string &path) : m_file(path)
+    {
+        if (!m_file.is_open())
+        {
+            throw std::runtime_error("cannot open corpus " + path);
+        }
+    }
+    /**
+     * @brief 取下一条记录
+     *
+     * @param index 记录在语料中的行号(跳过空行),从0开始
+     * @return false 语料已读完
+     */
+    bool next(CorpusRecord &record, int &index)
+    {
+        std::string line;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            do
+            {
+                if (!std::getline(m_file, line))
+                {
+                    return false;
+                }
+            } while (line.empty() || line == "\r");
+            index = m_index++;
+        }
+        record = parse_corpus_record(line);
+        return true;
+    }
+
+protected:
+    std::ifstream m_file;
+    std::mutex m_mutex;
+    int m_index = 0;
+};
+
+/**
+ * @brief 逐字段比较两个json,把不一致的字段路径追加到differences
+ *
+ * 数值之差不超过epsilon视为相同,数组与对象逐元素递归比较
+ */
+inline void diff_json(const configor::json &expected, const configor::json &actual, const std::string &path, double epsilon, std::vector<std::string> &differences)
+{
+    if (expected.is_number() && actual.is_number())
+    {
+        auto expected_value = expected.as_float();
+        auto actual_value = actual.as_float();
+        if (!(std::abs(expected_value - actual_value) <= epsilon))
+        {
+            differences.push_back(path + ": " + expected.dump() + " != " + actual.dump());
+        }
+        return;
+    }
+    if (expected.is_object() && actual.is_object())
+    {
+        for (auto iter = expected.begin(); iter != expected.end(); iter++)
+        {
+            auto key = iter.key();
+            if (actual.count(key) == 0)
+            {
+                differences.push_back(path + "." + key + ": missing");
+                continue;
+            }
+            diff_json(iter.value(), actual[key], path + "." + key, epsilon, differences);
+        }
+        for (auto iter = actual.begin(); iter != actual.end(); iter++)
+        {
+            if (expected.count(iter.key()) == 0)
+            {
+                differences.push_back(path + "." + iter.key() + ": unexpected");
+            }
+        }
+        return;
+    }
+    if (expected.is_array() && actual.is_array())
+    {
+        if (expected.size() != actual.size())
+        {
+            differences.push_back(path + ": size " + std::to_string(expected.size()) + " != " + std::to_string(actual.size()));
+            return;
+        }
+        for (auto i = 0; i < expected.size(); ++i)
+        {
+            diff_json(expected[i], actual[i], path + "[" + std::to_string(i) + "]", epsilon, differences);
+        }
+        return;
+    }
+    if (!(expected == actual))
+    {
+        differences.push_back(path + ": " + expected.dump() + " != " + actual.dump());
+    }
+}
+#endif
@@ -0,0 +1,430 @@
+//常驻评测服务:在Unix域套接字上接收长度前缀的请求,按参考字合批后由评测线程处理
+//用法: daemon --socket path [--threads N] [--queue N] [--batch N] [--batch-wait-us N]
+//             [--config config_file] [--reject 0|1] [--mat-pool 0|1]
+//             [--shm /name] [--shm-channels N] [--shm-ring-mb N] [--result-cache N] [--deadline-ms N]
+//--config为请求中config_line为空时使用的默认配置
+//--reject 1时队列满立即回复busy错误,否则阻塞读取形成背压
+//--shm另外创建N个共享内存通道/name.0 ... /name.N-1供同机前端使用,每个通道一个前端进程
+//--result-cache为缓存的结果数,大于0时与已评测请求相同的请求(按规范哈希)直接回复缓存的结果
+//--deadline-ms大于0时每个请求从收到起计时,超时后返回降级结果(error为9001),不再占用评测线程
+//收到SIGINT或SIGTERM后停止接收,处理完队列中的请求,输出统计后退出
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <thread>
+#include "server.h"
+#include "shm_ring.h"
+
+class DaemonOptions
+{
+public:
+    std::string socket_path;
+    int thread_count = 4;
+    BatchQueueOptions queue_options;
+    std::string config_line;
+    bool is_reject = false;
+    bool is_mat_pool = false;
+    std::string shm_name;
+    int shm_channel_count = 1;
+    std::uint64_t shm_ring_capacity = 16 * 1024 * 1024;
+    std::size_t result_cache_capacity = 0;
+    int deadline_ms = 0;
+};
+
+//收到请求时开始计时
+std::shared_ptr<CancellationToken> make_job_token(const DaemonOptions &options)
+{
+    return options.deadline_ms > 0 ? CancellationToken::with_timeout(std::chrono::milliseconds(options.deadline_ms)) : nullptr;
+}
+
+//一个客户端连接,读取线程与各评测线程共享;最后一个引用释放时关闭
+class DaemonConnection
+{
+public:
+    DaemonConnection(int fd) : fd(fd)
+    {
+    }
+    ~DaemonConnection()
+    {
+        ::close(fd);
+    }
+    bool write(const std::string &payload)
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        return write_frame(fd, payload);
+    }
+    int fd;
+    std::mutex write_mutex;
+};
+
+//一个共享内存通道,各评测线程都会写入响应环,写入时加锁保持单生产者
+class DaemonShmChannel
+{
+public:
+    DaemonShmChannel(std::unique_ptr<ShmChannel> channel) : channel(std::move(channel))
+    {
+    }
+    //前端1秒内没有腾出响应环空间时丢弃响应,不让评测线程一直等待
+    bool write(std::uint32_t id, ResultFormat format, const EvaluateResult &result, const std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        return write_shm_response(channel->get_response_ring(), id, format, result, error, deadline);
+    }
+    bool write(const std::string &payload)
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        return channel->get_response_ring().write(payload.data(), payload.size(), deadline);
+    }
+    std::unique_ptr<ShmChannel> channel;
+    std::mutex write_mutex;
+};
+
+std::atomic<bool> is_stopping{false};
+
+void handle_signal(int)
+{
+    is_stopping = true;
+}
+
+class ConnectionRegistry
+{
+public:
+    void add(const std::shared_ptr<DaemonConnection> &connection)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connections.insert(connection.get());
+        ++m_reader_count;
+    }
+    void remove(DaemonConnection *connection)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connections.erase(connection);
+        --m_reader_count;
+        m_changed.notify_all();
+    }
+    //停止时唤醒阻塞在recv上的读取线程,并等待全部退出
+    void shutdown_all()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (auto connection : m_connections)
+        {
+            ::shutdown(connection->fd, SHUT_RD);
+        }
+        m_changed.wait(lock, [&]()
+                       { return m_reader_count == 0; });
+    }
+
+protected:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::set<DaemonConnection *> m_connections;
+    int m_reader_count = 0;
+};
+
+void read_connection(const DaemonOptions &options, std::shared_ptr<DaemonConnection> connection, BatchQueue &queue, ScoringServerStats &stats, ConnectionRegistry &registry, ResultCache *result_cache)
+{
+    std::string payload;
+    try
+    {
+        while (read_frame(connection->fd, payload))
+        {
+            ScoreJob job;
+            try
+            {
+                job.envelope = parse_score_envelope(payload);
+            }
+            catch (const std::exception &e)
+            {
+                ++stats.rejected_count;
+                connection->write(dump_score_response(0, ResultFormat::json, EvaluateResult(), std::string("bad request: ") + e.what()));
+                continue;
+            }
+            if (job.envelope.request.config_line.empty())
+            {
+                job.envelope.request.config_line = options.config_line;
+            }
+            job.reference_key = get_reference_key(job.envelope.request);
+            auto id = job.envelope.id;
+            auto format = job.envelope.format;
+            auto cached = result_cache != nullptr ? result_cache->find(job.envelope.request_hash, job.envelope.flags) : nullptr;
+            if (cached)
+            {
+                connection->write(dump_cached_response(id, format, *cached));
+                continue;
+            }
+            job.reply = [connection, id, format](const EvaluateResult &result, const std::string &error)
+            {
+                connection->write(dump_score_response(id, format, result, error));
+            };
+            job.token = make_job_token(options);
+            if (!queue.push(std::move(job), !options.is_reject))
+            {
+                ++stats.rejected_count;
+                connection->write(dump_score_response(id, format, EvaluateResult(), "busy"));
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "connection closed: %s\n", e.what());
+    }
+    registry.remove(connection.get());
+}
+
+//共享内存通道的读取线程:在请求环内原地解析请求后释放记录,停止时返回
+void read_shm_channel(const DaemonOptions &options, std::shared_ptr<DaemonShmChannel> channel, BatchQueue &queue, ScoringServerStats &stats, ResultCache *result_cache)
+{
+    auto &ring = channel->channel->get_request_ring();
+    ShmBackoff backoff;
+    while (!is_stopping)
+    {
+        std::size_t size;
+        const char *data;
+        try
+        {
+            data = ring.peek(size);
+        }
+        catch (const std::exception &e)
+        {
+            //记录长度被改写后无法找到下一条记录的边界,丢弃环中全部请求
+            ring.drain();
+            ++stats.rejected_count;
+            channel->write(0, ResultFormat::json, EvaluateResult(), std::string("bad request: ") + e.what());
+            continue;
+        }
+        if (data == nullptr)
+        {
+            backoff.wait();
+            continue;
+        }
+        backoff.reset();
+        ScoreJob job;
+        try
+        {
+            BinaryReader reader(data, size);
+            job.envelope = read_score_envelope(reader);
+        }
+        catch (const std::exception &e)
+        {
+            ring.release();
+            ++stats.rejected_count;
+            channel->write(0, ResultFormat::json, EvaluateResult(), std::string("bad request: ") + e.what());
+            continue;
+        }
+        ring.release();
+        if (job.envelope.request.config_line.empty())
+        {
+            job.envelope.request.config_line = options.config_line;
+        }
+        job.reference_key = get_reference_key(job.envelope.request);
+        auto id = job.envelope.id;
+        auto format = job.envelope.format;
+        auto cached = result_cache != nullptr ? result_cache->find(job.envelope.request_hash, job.envelope.flags) : nullptr;
+        if (cached)
+        {
+            if (!channel->write(dump_cached_response(id, format, *cached)))
+            {
+                ++stats.dropped_count;
+            }
+            continue;
+        }
+        job.reply = [channel, &stats, id, format](const EvaluateResult &result, const std::string &error)
+        {
+            if (!channel->write(id, format, result, error))
+            {
+                ++stats.dropped_count;
+            }
+        };
+        job.token = make_job_token(options);
+        if (!queue.push(std::move(job), !options.is_reject))
+        {
+            ++stats.rejected_count;
+            channel->write(id, format, EvaluateResult(), "busy");
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    DaemonOptions options;
+    for (auto i = 1; i + 1 < argc; i += 2)
+    {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+        if (name == "--socket")
+        {
+            options.socket_path = value;
+        }
+        else if (name == "--threads")
+        {
+            options.thread_count = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--queue")
+        {
+            options.queue_options.capacity = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--batch")
+        {
+            options.queue_options.max_batch_size = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--batch-wait-us")
+        {
+            options.queue_options.batch_wait_us = std::atoi(value.c_str());
+        }
+        else if (name == "--config")
+        {
+            std::ifstream config_file(value);
+            std::stringstream config_stream;
+            config_stream << config_file.rdbuf();
+            options.config_line = config_stream.str();
+        }
+        else if (name == "--reject")
+        {
+            options.is_reject = value != "0";
+        }
+        else if (name == "--mat-pool")
+        {
+            options.is_mat_pool = value != "0";
+        }
+        else if (name == "--shm")
+        {
+            options.shm_name = value;
+        }
+        else if (name == "--shm-channels")
+        {
+            options.shm_channel_count = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--shm-ring-mb")
+        {
+            options.shm_ring_capacity = (std::uint64_t)std::max(1, std::atoi(value.c_str())) * 1024 * 1024;
+        }
+        else if (name == "--result-cache")
+        {
+            options.result_cache_capacity = (std::size_t)std::max(0, std::atoi(value.c_str()));
+        }
+        else if (name == "--deadline-ms")
+        {
+            options.deadline_ms = std::max(0, std::atoi(value.c_str()));
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", name.c_str());
+            return 1;
+        }
+    }
+    if (options.socket_path.empty())
+    {
+        std::fprintf(stderr, "usage: %s --socket path [--threads N] [--queue N] [--batch N] [--batch-wait-us N] [--config config_file] [--reject 0|1] [--mat-pool 0|1] [--shm /name] [--shm-channels N] [--shm-ring-mb N] [--result-cache N] [--deadline-ms N]\n", argv[0]);
+        return 1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options.socket_path.size() >= sizeof(address.sun_path))
+    {
+        std::fprintf(stderr, "socket path too long\n");
+        return 1;
+    }
+    std::strcpy(address.sun_path, options.socket_path.c_str());
+    auto listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(options.socket_path.c_str());
+    if (listen_fd < 0 || ::bind(listen_fd, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(listen_fd, 128) != 0)
+    {
+        std::perror("listen");
+        return 1;
+    }
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    BatchQueue queue(options.queue_options);
+    ScoringServerStats stats;
+    ConnectionRegistry registry;
+    std::unique_ptr<ResultCache> result_cache;
+    if (options.result_cache_capacity > 0)
+    {
+        ResultCacheOptions cache_options;
+        cache_options.capacity = options.result_cache_capacity;
+        result_cache = std::make_unique<ResultCache>(cache_options);
+    }
+    std::vector<std::thread> workers;
+    for (auto i = 0; i < options.thread_count; ++i)
+    {
+        workers.emplace_back([&]()
+                             { run_scoring_worker(
+                                   queue, stats, [&](Manager &manager)
+                                   { manager.set_mat_pool(options.is_mat_pool); },
+                                   result_cache.get()); });
+    }
+
+    std::vector<std::thread> shm_readers;
+    if (!options.shm_name.empty())
+    {
+        for (auto i = 0; i < options.shm_channel_count; ++i)
+        {
+            std::shared_ptr<DaemonShmChannel> channel;
+            try
+            {
+                channel = std::make_shared<DaemonShmChannel>(ShmChannel::create(options.shm_name + "." + std::to_string(i), options.shm_ring_capacity));
+            }
+            catch (const std::exception &e)
+            {
+                std::fprintf(stderr, "%s\n", e.what());
+                is_stopping = true;
+                break;
+            }
+            shm_readers.emplace_back([&, channel]()
+                                     { read_shm_channel(options, channel, queue, stats, result_cache.get()); });
+        }
+    }
+
+    while (!is_stopping)
+    {
+        pollfd poll_fd{listen_fd, POLLIN, 0};
+        if (::poll(&poll_fd, 1, 200) <= 0)
+        {
+            continue;
+        }
+        auto fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            continue;
+        }
+        auto connection = std::make_shared<DaemonConnection>(fd);
+        registry.add(connection);
+        std::thread([&, connection]()
+                    { read_connection(options, connection, queue, stats, registry, result_cache.get()); })
+            .detach();
+    }
+
+    ::close(listen_fd);
+    ::unlink(options.socket_path.c_str());
+    registry.shutdown_all();
+    for (auto &reader : shm_readers)
+    {
+        reader.join();
+    }
+    queue.close();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    auto res = stats.to_json();
+    if (result_cache)
+    {
+        res["result_cache"] = result_cache->to_json();
+    }
+    std::printf("%s\n", res.dump().c_str());
+    return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+
+//详细评测因截止时间或取消而降级时parse_to_old结果中的error
+constexpr int DEADLINE_EXCEEDED_ERROR = 9001;
+
+//评测超过截止时间或被取消,由检查点抛出
+class DeadlineException : public std::exception
+{
+public:
+    const char *what() const noexcept override
+    {
+        return "deadline exceeded";
+    }
+};
+
+/**
+ * @brief 一次评测的截止时间与取消标志
+ *
+ * 评测线程在各阶段开始时(StageTimer)与耗时的循环中检查,其他线程可随时cancel
+ */
+class CancellationToken
+{
+public:
+    static std::shared_ptr<CancellationToken> with_timeout(std::chrono::nanoseconds timeout)
+    {
+        auto token = std::make_shared<CancellationToken>();
+        token->set_deadline(std::chrono::steady_clock::now() + timeout);
+        return token;
+    }
+    void set_deadline(std::chrono::steady_clock::time_point deadline)
+    {
+        m_deadline = deadline;
+        m_has_deadline = true;
+    }
+    void cancel()
+    {
+        m_is_cancelled = true;
+    }
+    bool is_cancelled() const
+    {
+        return m_is_cancelled || (m_has_deadline && std::chrono::steady_clock::now() >= m_deadline);
+    }
+    void check() const
+    {
+        if (is_cancelled())
+        {
+            throw DeadlineException();
+        }
+    }
+
+protected:
+    std::atomic<bool> m_is_cancelled{false};
+    bool m_has_deadline = false;
+    std::chrono::steady_clock::time_point m_deadline;
+};
+
+//当前线程正在评测的请求的取消标志,为空时不检查
+inline const CancellationToken *&get_thread_cancellation_token()
+{
+    thread_local const CancellationToken *token = nullptr;
+    return token;
+}
+
+//作用域内当前线程的检查点检查token,可嵌套
+class CancellationScope
+{
+public:
+    CancellationScope(const CancellationToken *token) : m_previous(get_thread_cancellation_token())
+    {
+        get_thread_cancellation_token() = token;
+    }
+    ~CancellationScope()
+    {
+        get_thread_cancellation_token() = m_previous;
+    }
+    CancellationScope(const CancellationScope &) = delete;
+    CancellationScope &operator=(const CancellationScope &) = delete;
+
+protected:
+    const CancellationToken *m_previous;
+};
+
+//检查点:当前请求已超时或被取消时抛出DeadlineException
+inline void check_cancellation()
+{
+    auto token = get_thread_cancellation_token();
+    if (token != nullptr)
+    {
+        token->check();
+    }
+}
+#endif
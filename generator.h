@@ -0,0 +1,228 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "configor/json.hpp"
+#include "synthetic.h"
+
+//由标准字生成测试字时的变化幅度
+class GeneratorOptions
+{
+public:
+    double max_translation = 0.05;   //整字平移,书写区域边长的比例
+    double min_scale = 0.85;         //整字缩放
+    double max_scale = 1.15;
+    double max_rotation = 0.08;      //整字旋转,弧度
+    double stroke_jitter = 0.02;     //每笔整体偏移的标准差,书写区域边长的比例
+    double point_jitter = 0.003;     //每个点抖动的标准差,书写区域边长的比例
+    double missing_stroke_rate = 0.05; //每笔漏写的概率
+    double extra_stroke_rate = 0.05;   //每笔之后多写一笔的概率
+    double swap_rate = 0.05;           //相邻两笔书写顺序对调的概率
+    bool is_timestamp = false;         //是否输出每个点的时间戳t
+    double point_interval = 8.0;       //相邻点的时间间隔,毫秒
+    double stroke_interval = 250.0;    //笔画之间的停顿,毫秒
+};
+
+/**
+ * @brief 由一个标准字生成可复现的测试字,用于压力测试与基准测试
+ *
+ * 标准字的dot只在构造时解析一次,之后每个测试字只做坐标变换与字符串拼接
+ * 第index个测试字只由seed与index决定,可在多个线程中按index并行生成
+ */
+class HandwritingGenerator
+{
+public:
+    /**
+     * @param reference 标准字请求,使用其中的standard_lines, stroke_info_array(笔画名), char_info, struction_info_array, config_line
+     */
+    HandwritingGenerator(ScoreRequest reference, GeneratorOptions options, std::uint64_t seed)
+        : m_reference(reference), m_options(options), m_seed(seed)
+    {
+        for (auto line : reference.standard_lines)
+        {
+            auto line_obj = configor::json::parse(line);
+            DotArea area;
+            area.start_x = line_obj["startX"].as_float();
+            area.start_y = line_obj["startY"].as_float();
+            area.end_x = line_obj["endX"].as_float();
+            area.end_y = line_obj["endY"].as_float();
+            std::vector<cv::Point2d> points;
+            for (auto item : line_obj["list"])
+            {
+                points.push_back(cv::Point2d(item["x"].as_float(), item["y"].as_float()));
+            }
+            m_areas.push_back(area);
+            m_strokes.push_back(points);
+        }
+        auto point_count = 0;
+        for (auto &points : m_strokes)
+        {
+            for (auto &point : points)
+            {
+                m_center.x += point.x;
+                m_center.y += point.y;
+                ++point_count;
+            }
+        }
+        if (point_count != 0)
+        {
+            m_center.x /= point_count;
+            m_center.y /= point_count;
+        }
+        if (!m_areas.empty())
+        {
+            m_size = std::max(m_areas[0].end_x - m_areas[0].start_x, m_areas[0].end_y - m_areas[0].start_y);
+        }
+        m_struction_stroke_orders = get_struction_stroke_orders(reference.stroke_info_array, m_strokes.size());
+    }
+    //生成下一个测试字
+    ScoreRequest generate()
+    {
+        return generate(m_next_index++);
+    }
+    /**
+     * @brief 生成第index个测试字
+     *
+     * 输出的stroke_info_array按标准字笔画顺序排列,order为标准字笔画序号,
+     * segment_index_array为该笔在测试字中的书写序号,漏写的笔画is_skip为true,
+     * 部件的stroke_index_array换算为未漏写笔画中的序号,漏写的笔画从部件中去掉
+     */
+    ScoreRequest generate(std::uint64_t index)
+    {
+        std::mt19937_64 random(mix(m_seed + index));
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        auto request = m_reference;
+        request.evaluate_lines.clear();
+        request.stroke_info_array.clear();
+        request.is_character_right = true;
+
+        //书写顺序,-1表示多写的笔画
+        std::vector<int> written_order;
+        std::vector<int> extra_source;
+        for (auto i = 0; i < m_strokes.size(); ++i)
+        {
+            if (uniform(random) >= m_options.missing_stroke_rate || m_strokes.size() == 1)
+            {
+                written_order.push_back(i);
+            }
+            if (uniform(random) < m_options.extra_stroke_rate)
+            {
+                written_order.push_back(-1);
+                extra_source.push_back((int)(uniform(random) * m_strokes.size()) % m_strokes.size());
+            }
+        }
+        for (auto i = 0; i + 1 < written_order.size(); ++i)
+        {
+            if (uniform(random) < m_options.swap_rate)
+            {
+                std::swap(written_order[i], written_order[i + 1]);
+                ++i;
+            }
+        }
+
+        auto scale = m_options.min_scale + (m_options.max_scale - m_options.min_scale) * uniform(random);
+        auto rotation = m_options.max_rotation * (2 * uniform(random) - 1);
+        auto cos_rotation = std::cos(rotation) * scale;
+        auto sin_rotation = std::sin(rotation) * scale;
+        auto translation_x = m_options.max_translation * m_size * (2 * uniform(random) - 1);
+        auto translation_y = m_options.max_translation * m_size * (2 * uniform(random) - 1);
+        auto point_jitter = m_options.point_jitter * m_size;
+
+        std::vector<int> segment_index_array(m_strokes.size(), -1);
+        std::vector<cv::Point2d> points;
+        std::vector<double> times;
+        auto time = 0.0;
+        auto extra_index = 0;
+        for (auto segment_index = 0; segment_index < written_order.size(); ++segment_index)
+        {
+            auto stroke_index = written_order[segment_index];
+            auto offset_x = m_options.stroke_jitter * m_size * normal(random);
+            auto offset_y = m_options.stroke_jitter * m_size * normal(random);
+            if (stroke_index == -1)
+            {
+                //多写的一笔:复制另一笔并明显错开
+                stroke_index = extra_source[extra_index++];
+                offset_x += 0.2 * m_size * (2 * uniform(random) - 1);
+                offset_y += 0.2 * m_size * (2 * uniform(random) - 1);
+            }
+            else
+            {
+                segment_index_array[stroke_index] = segment_index;
+            }
+            auto &source = m_strokes[stroke_index];
+            points.clear();
+            times.clear();
+            for (auto &point : source)
+            {
+                auto dx = point.x - m_center.x;
+                auto dy = point.y - m_center.y;
+                auto x = m_center.x + cos_rotation * dx - sin_rotation * dy + translation_x + offset_x + point_jitter * normal(random);
+                auto y = m_center.y + sin_rotation * dx + cos_rotation * dy + translation_y + offset_y + point_jitter * normal(random);
+                points.push_back(cv::Point2d(x, y));
+                if (m_options.is_timestamp)
+                {
+                    times.push_back(time);
+                    time += m_options.point_interval * (0.5 + uniform(random));
+                }
+            }
+            time += m_options.stroke_interval * (0.5 + uniform(random));
+            request.evaluate_lines.push_back(make_dot_line(points, times, m_areas[stroke_index]));
+        }
+
+        for (auto i = 0; i < m_strokes.size(); ++i)
+        {
+            StrokeInfo stroke_info;
+            if (i < m_reference.stroke_info_array.size())
+            {
+                stroke_info = m_reference.stroke_info_array[i];
+            }
+            stroke_info.order = i;
+            stroke_info.is_valid = true;
+            stroke_info.is_skip = segment_index_array[i] == -1;
+            stroke_info.is_reliable = !stroke_info.is_skip;
+            stroke_info.segment_index_array.clear();
+            if (!stroke_info.is_skip)
+            {
+                stroke_info.segment_index_array.push_back(segment_index_array[i]);
+            }
+            request.stroke_info_array.push_back(stroke_info);
+        }
+        remap_struction_strokes(request.struction_info_array, request.char_info, m_struction_stroke_orders, request.stroke_info_array);
+        return request;
+    }
+    //生成第start_index起的count个测试字
+    std::vector<ScoreRequest> generate_batch(std::uint64_t start_index, int count)
+    {
+        std::vector<ScoreRequest> requests;
+        requests.reserve(count);
+        for (auto i = 0; i < count; ++i)
+        {
+            requests.push_back(generate(start_index + i));
+        }
+        return requests;
+    }
+
+protected:
+    // splitmix64,使相邻index得到不相关的随机数种子
+    static std::uint64_t mix(std::uint64_t value)
+    {
+        value += 0x9e3779b97f4a7c15ULL;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+    ScoreRequest m_reference;
+    GeneratorOptions m_options;
+    std::uint64_t m_seed;
+    std::uint64_t m_next_index = 0;
+    std::vector<DotArea> m_areas;
+    std::vector<std::vector<cv::Point2d>> m_strokes;
+    std::vector<int> m_struction_stroke_orders; //标准字部件中各序号对应的笔画序号
+    cv::Point2d m_center;
+    double m_size = SYNTHETIC_CANVAS_SIZE;
+};
+#endif
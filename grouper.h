@@ -0,0 +1,242 @@
+#ifndef GROUPER_H
+#define GROUPER_H
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "info.h"
+#include "mapper.h"
+
+class StructionGrouperOptions
+{
+public:
+    double overlap_tolerance = 0.02; //投影重叠不超过该值(书写区域边长的比例)时仍视为相离
+    double frame_span_ratio = 0.6;   //包围结构中宽或高超过整字该比例的笔画归入外框
+};
+
+/**
+ * @brief 按结构类型把笔画分成部件,输出与传入的StructionInfo相同的格式
+ *
+ * 左右(⿰⿲)与上下(⿱⿳)结构:笔画外接矩形在对应方向上的投影相交即相邻,相邻的笔画为一个部件,
+ * 部件多于结构类型的部件数时合并间隙最小的相邻部件,少于时在笔画中心间隙最大处拆开笔画最多的部件
+ * 包围结构(⿴⿵⿶⿷⿸⿹⿺):跨度大的笔画为外框,其余为内部
+ * 其他结构为一个部件
+ * 只使用标准字的笔画,stroke_index_array是未跳过笔画中的序号,与get_stroke_map一致
+ */
+class StructionGrouper
+{
+public:
+    StructionGrouper(StructionGrouperOptions options = StructionGrouperOptions()) : m_options(options)
+    {
+    }
+    std::vector<StructionInfo> group(
+        const std::vector<std::string> &standard_lines,
+        const std::vector<StrokeInfo> &stroke_info_array,
+        const std::string &layout)
+    {
+        return group(parse_dot_lines(standard_lines), stroke_info_array, layout);
+    }
+    //使用已解析的标准字dot
+    std::vector<StructionInfo> group(
+        const std::vector<DotLine> &standard_dots,
+        const std::vector<StrokeInfo> &stroke_info_array,
+        const std::string &layout)
+    {
+        std::vector<cv::Rect2d> rects;
+        for (auto &stroke_info : stroke_info_array)
+        {
+            if (stroke_info.is_skip)
+            {
+                continue;
+            }
+            if (stroke_info.order < 0 || stroke_info.order >= standard_dots.size())
+            {
+                return {};
+            }
+            rects.push_back(get_rect(standard_dots[stroke_info.order].points));
+        }
+        if (rects.empty())
+        {
+            return {};
+        }
+        std::vector<std::vector<int>> groups;
+        if (layout == "⿰" || layout == "⿲")
+        {
+            groups = group_by_projection(rects, true, layout == "⿰" ? 2 : 3);
+        }
+        else if (layout == "⿱" || layout == "⿳")
+        {
+            groups = group_by_projection(rects, false, layout == "⿱" ? 2 : 3);
+        }
+        else if (layout == "⿴" || layout == "⿵" || layout == "⿶" || layout == "⿷" || layout == "⿸" || layout == "⿹" || layout == "⿺")
+        {
+            groups = group_by_frame(rects);
+        }
+        else
+        {
+            groups.push_back(std::vector<int>());
+            for (auto i = 0; i < rects.size(); ++i)
+            {
+                groups.back().push_back(i);
+            }
+        }
+        std::vector<StructionInfo> struction_info_array;
+        for (auto &group : groups)
+        {
+            StructionInfo struction_info;
+            struction_info.stroke_index_array = group;
+            struction_info_array.push_back(struction_info);
+        }
+        return struction_info_array;
+    }
+
+protected:
+    static cv::Rect2d get_rect(const std::vector<cv::Point2d> &points)
+    {
+        if (points.empty())
+        {
+            return cv::Rect2d();
+        }
+        auto min_x = points[0].x, max_x = points[0].x, min_y = points[0].y, max_y = points[0].y;
+        for (auto &point : points)
+        {
+            min_x = std::min(min_x, point.x);
+            max_x = std::max(max_x, point.x);
+            min_y = std::min(min_y, point.y);
+            max_y = std::max(max_y, point.y);
+        }
+        return cv::Rect2d(min_x, min_y, max_x - min_x, max_y - min_y);
+    }
+    //按投影分组,结果按坐标从小到大排列,组内为笔画序号升序
+    std::vector<std::vector<int>> group_by_projection(const std::vector<cv::Rect2d> &rects, bool is_horizontal, int struction_count)
+    {
+        auto get_begin = [&](int i)
+        { return is_horizontal ? rects[i].x : rects[i].y; };
+        auto get_end = [&](int i)
+        { return is_horizontal ? rects[i].x + rects[i].width : rects[i].y + rects[i].height; };
+        std::vector<int> indexes(rects.size());
+        for (auto i = 0; i < indexes.size(); ++i)
+        {
+            indexes[i] = i;
+        }
+        std::sort(indexes.begin(), indexes.end(), [&](int x, int y)
+                  { return get_begin(x) < get_begin(y); });
+
+        //投影相交的笔画连成一组
+        std::vector<std::vector<int>> groups;
+        std::vector<double> group_ends;
+        for (auto i : indexes)
+        {
+            if (groups.empty() || get_begin(i) >= group_ends.back() - m_options.overlap_tolerance)
+            {
+                groups.push_back({i});
+                group_ends.push_back(get_end(i));
+            }
+            else
+            {
+                groups.back().push_back(i);
+                group_ends.back() = std::max(group_ends.back(), get_end(i));
+            }
+        }
+
+        //合并间隙最小的相邻两组
+        while (groups.size() > struction_count)
+        {
+            auto best = 0;
+            auto best_gap = 0.0;
+            for (auto k = 0; k + 1 < groups.size(); ++k)
+            {
+                auto next_begin = get_begin(groups[k + 1][0]);
+                for (auto i : groups[k + 1])
+                {
+                    next_begin = std::min(next_begin, get_begin(i));
+                }
+                auto gap = next_begin - group_ends[k];
+                if (k == 0 || gap < best_gap)
+                {
+                    best = k;
+                    best_gap = gap;
+                }
+            }
+            groups[best].insert(groups[best].end(), groups[best + 1].begin(), groups[best + 1].end());
+            group_ends[best] = std::max(group_ends[best], group_ends[best + 1]);
+            groups.erase(groups.begin() + best + 1);
+            group_ends.erase(group_ends.begin() + best + 1);
+        }
+
+        //拆开笔画最多的一组
+        while (groups.size() < struction_count)
+        {
+            auto k = (int)(std::max_element(groups.begin(), groups.end(), [](auto &x, auto &y)
+                                            { return x.size() < y.size(); }) -
+                           groups.begin());
+            if (groups[k].size() < 2)
+            {
+                break;
+            }
+            auto get_center = [&](int i)
+            { return (get_begin(i) + get_end(i)) / 2; };
+            auto group = groups[k];
+            std::sort(group.begin(), group.end(), [&](int x, int y)
+                      { return get_center(x) < get_center(y); });
+            auto split = 1;
+            for (auto i = 1; i < group.size(); ++i)
+            {
+                if (get_center(group[i]) - get_center(group[i - 1]) > get_center(group[split]) - get_center(group[split - 1]))
+                {
+                    split = i;
+                }
+            }
+            std::vector<int> first(group.begin(), group.begin() + split);
+            std::vector<int> second(group.begin() + split, group.end());
+            auto get_group_end = [&](const std::vector<int> &items)
+            {
+                auto end = get_end(items[0]);
+                for (auto i : items)
+                {
+                    end = std::max(end, get_end(i));
+                }
+                return end;
+            };
+            groups[k] = first;
+            group_ends[k] = get_group_end(first);
+            groups.insert(groups.begin() + k + 1, second);
+            group_ends.insert(group_ends.begin() + k + 1, get_group_end(second));
+        }
+        for (auto &group : groups)
+        {
+            std::sort(group.begin(), group.end());
+        }
+        return groups;
+    }
+    //外框在前,内部在后
+    std::vector<std::vector<int>> group_by_frame(const std::vector<cv::Rect2d> &rects)
+    {
+        auto character_rect = rects[0];
+        for (auto &rect : rects)
+        {
+            auto left = std::min(character_rect.x, rect.x);
+            auto top = std::min(character_rect.y, rect.y);
+            auto right = std::max(character_rect.x + character_rect.width, rect.x + rect.width);
+            auto bottom = std::max(character_rect.y + character_rect.height, rect.y + rect.height);
+            character_rect = cv::Rect2d(left, top, right - left, bottom - top);
+        }
+        std::vector<int> frame;
+        std::vector<int> inner;
+        for (auto i = 0; i < rects.size(); ++i)
+        {
+            auto is_frame = rects[i].width >= m_options.frame_span_ratio * character_rect.width ||
+                            rects[i].height >= m_options.frame_span_ratio * character_rect.height;
+            (is_frame ? frame : inner).push_back(i);
+        }
+        if (frame.empty() || inner.empty())
+        {
+            frame.insert(frame.end(), inner.begin(), inner.end());
+            std::sort(frame.begin(), frame.end());
+            return {frame};
+        }
+        return {frame, inner};
+    }
+    StructionGrouperOptions m_options;
+};
+#endif
@@ -0,0 +1,238 @@
+//评测服务的本机压测:多个连接各自保持若干个未完成的请求,输出吞吐与端到端延迟分位数
+//用法: loadtest --socket path|--shm /name [--connections N] [--depth N] [--requests N] [--corpus corpus.jsonl]
+//               [--config config_file] [--references N] [--format json|binary] [--mode detail|holistic|both]
+//没有--corpus时使用合成字,--references为不同参考字的个数,用于观察合批效果
+//--requests为每个连接发送的请求数
+//--shm时第i个连接使用共享内存通道/name.i,服务端的--shm-channels不能少于--connections;
+//同样参数分别以--socket与--shm运行即可比较两种传输的延迟
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "client.h"
+#include "corpus.h"
+#include "profiler.h"
+#include "synthetic.h"
+
+class LoadTestOptions
+{
+public:
+    std::string socket_path;
+    std::string shm_name;
+    int connection_count = 4;
+    int depth = 4;
+    int request_count = 1000;
+    std::string corpus_path;
+    std::string config_line;
+    int reference_count = 8;
+    ResultFormat format = ResultFormat::json;
+    int flags = EVALUATE_DETAIL | EVALUATE_HOLISTIC;
+};
+
+class LoadTestWorkerStats
+{
+public:
+    std::unique_ptr<LatencyHistogram> histogram = std::make_unique<LatencyHistogram>();
+    int response_count = 0;
+    int error_count = 0;
+};
+
+std::vector<ScoreRequest> load_requests(const LoadTestOptions &options)
+{
+    std::vector<ScoreRequest> requests;
+    if (!options.corpus_path.empty())
+    {
+        CorpusReader reader(options.corpus_path);
+        CorpusRecord record;
+        int index = 0;
+        while (reader.next(record, index))
+        {
+            requests.push_back(record.request);
+        }
+    }
+    else
+    {
+        std::vector<std::string> layout_array{" ", "⿰", "⿱"};
+        for (auto i = 0; i < options.reference_count; ++i)
+        {
+            SyntheticOptions synthetic_options;
+            synthetic_options.layout = layout_array[i % layout_array.size()];
+            synthetic_options.stroke_count = 3 + i % 8;
+            synthetic_options.points_per_stroke = 32;
+            synthetic_options.seed = i + 1;
+            requests.push_back(make_synthetic_request(synthetic_options));
+        }
+    }
+    for (auto &request : requests)
+    {
+        if (!options.config_line.empty())
+        {
+            request.config_line = options.config_line;
+        }
+    }
+    return requests;
+}
+
+template <typename Client>
+void run_connection(Client &client, const LoadTestOptions &options, const std::vector<ScoreRequest> &requests, int connection_index, LoadTestWorkerStats &stats)
+{
+    std::unordered_map<std::uint32_t, std::chrono::steady_clock::time_point> send_times;
+    auto sent_count = 0;
+    auto send_next = [&]()
+    {
+        ScoreEnvelope envelope;
+        envelope.id = client.get_id_base() + (std::uint32_t)sent_count + 1;
+        envelope.flags = options.flags;
+        envelope.format = options.format;
+        envelope.request = requests[(connection_index + sent_count) % requests.size()];
+        send_times[envelope.id] = std::chrono::steady_clock::now();
+        client.send(envelope);
+        ++sent_count;
+    };
+    while (sent_count < options.request_count && sent_count < options.depth)
+    {
+        send_next();
+    }
+    while (stats.response_count < sent_count)
+    {
+        auto response = client.receive();
+        auto iter = send_times.find(response.id);
+        if (iter == send_times.end())
+        {
+            //接管共享内存通道时上一个前端留下的请求的响应
+            continue;
+        }
+        stats.histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - iter->second).count());
+        send_times.erase(iter);
+        ++stats.response_count;
+        stats.error_count += !response.error.empty();
+        if (sent_count < options.request_count)
+        {
+            send_next();
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    LoadTestOptions options;
+    for (auto i = 1; i + 1 < argc; i += 2)
+    {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+        if (name == "--socket")
+        {
+            options.socket_path = value;
+        }
+        else if (name == "--shm")
+        {
+            options.shm_name = value;
+        }
+        else if (name == "--connections")
+        {
+            options.connection_count = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--depth")
+        {
+            options.depth = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--requests")
+        {
+            options.request_count = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--corpus")
+        {
+            options.corpus_path = value;
+        }
+        else if (name == "--config")
+        {
+            std::ifstream config_file(value);
+            std::stringstream config_stream;
+            config_stream << config_file.rdbuf();
+            options.config_line = config_stream.str();
+        }
+        else if (name == "--references")
+        {
+            options.reference_count = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--format")
+        {
+            options.format = value == "binary" ? ResultFormat::binary : ResultFormat::json;
+        }
+        else if (name == "--mode")
+        {
+            options.flags = (value != "holistic" ? EVALUATE_DETAIL : 0) | (value != "detail" ? EVALUATE_HOLISTIC : 0);
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", name.c_str());
+            return 1;
+        }
+    }
+    if (options.socket_path.empty() == options.shm_name.empty())
+    {
+        std::fprintf(stderr, "usage: %s --socket path|--shm /name [--connections N] [--depth N] [--requests N] [--corpus corpus.jsonl] [--config config_file] [--references N] [--format json|binary] [--mode detail|holistic|both]\n", argv[0]);
+        return 1;
+    }
+    auto requests = load_requests(options);
+    if (requests.empty())
+    {
+        std::fprintf(stderr, "no requests\n");
+        return 1;
+    }
+
+    std::vector<LoadTestWorkerStats> stats(options.connection_count);
+    std::vector<std::thread> threads;
+    auto begin = std::chrono::steady_clock::now();
+    for (auto i = 0; i < options.connection_count; ++i)
+    {
+        threads.emplace_back([&, i]()
+                             {
+                                 try
+                                 {
+                                     if (options.shm_name.empty())
+                                     {
+                                         ScoringClient client(options.socket_path);
+                                         run_connection(client, options, requests, i, stats[i]);
+                                     }
+                                     else
+                                     {
+                                         ShmScoringClient client(options.shm_name + "." + std::to_string(i));
+                                         run_connection(client, options, requests, i, stats[i]);
+                                     }
+                                 }
+                                 catch (const std::exception &e)
+                                 {
+                                     std::fprintf(stderr, "connection %d: %s\n", i, e.what());
+                                 }
+                             });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    HistogramSnapshot snapshot;
+    auto response_count = 0;
+    auto error_count = 0;
+    for (auto &item : stats)
+    {
+        snapshot.merge(*item.histogram);
+        response_count += item.response_count;
+        error_count += item.error_count;
+    }
+    std::printf(
+        "{\"transport\":\"%s\",\"connections\":%d,\"depth\":%d,\"responses\":%d,\"errors\":%d,\"seconds\":%.3f,\"requests_per_second\":%.1f,"
+        "\"mean_ns\":%.0f,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}\n",
+        options.shm_name.empty() ? "socket" : "shm", options.connection_count, options.depth, response_count, error_count, seconds, seconds > 0 ? response_count / seconds : 0.0,
+        snapshot.mean(),
+        (unsigned long long)snapshot.percentile(0.5),
+        (unsigned long long)snapshot.percentile(0.9),
+        (unsigned long long)snapshot.percentile(0.99),
+        (unsigned long long)snapshot.max);
+    return error_count == 0 && response_count == options.connection_count * options.request_count ? 0 : 2;
+}
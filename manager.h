@@ -1,6 +1,7 @@
 #ifndef MANAGER_H
 #define MANAGER_H
 #include <cmath>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 #include "configor/json.hpp"
@@ -14,6 +15,21 @@
 #include "info.h"
 #include "utils.h"
 #include "exceptions.h"
+#include "canvas.h"
+#include "resample.h"
+#include "request.h"
+#include "profiler.h"
+#include "capture.h"
+#include "trace.h"
+#include "memory.h"
+#include "mat_pool.h"
+#include "alignment.h"
+#include "mapper.h"
+#include "verifier.h"
+#include "stroke_order.h"
+#include "speed.h"
+#include "grouper.h"
+#include "reference_store.h"
 //表示笔画评论，语音，笔画序号
 class StrokeCommentMessageInfo 
 {
@@ -63,6 +79,7 @@ public:
      */
     void get_stroke_map(Character &ch, std::vector<Segment> segments, CharacterInfo char_info, std::vector<StructionInfo> struction_info_array, std::vector<StrokeInfo> stroke_info_array, bool is_standard)
     {
+        StageTimer timer(Stage::stroke_map);
         // is_standard==true:构造标准字,假定标准字
         // is_standard==false:构造测试字
 
@@ -131,13 +148,46 @@ public:
 
     std::vector<Segment> load_from_content(std::vector<std::string> lines, Config config)
     {
+        std::vector<SegmentPointCount> point_counts;
+        return load_from_content(lines, config, point_counts);
+    }
+    /**
+     * @brief 读取笔画段,按m_resample_options重采样
+     *
+     * @param point_counts 输出每个笔画段重采样前后的点数
+     */
+    std::vector<Segment> load_from_content(std::vector<std::string> lines, Config config, std::vector<SegmentPointCount> &point_counts)
+    {
+        std::vector<SegmentTiming> segment_timings;
+        return load_from_content(lines, config, point_counts, segment_timings);
+    }
+    /**
+     * @brief 读取笔画段,同时累计每个点的时间戳t,得到各段的书写时间与停顿
+     *
+     * @param segment_timings 输出每个笔画段的时间统计,点没有t字段时has_time为false
+     */
+    std::vector<Segment> load_from_content(std::vector<std::string> lines, Config config, std::vector<SegmentPointCount> &point_counts, std::vector<SegmentTiming> &segment_timings)
+    {
+        StageTimer timer(Stage::segment_load);
         std::vector<Segment> segments;
         std::vector<configor::json> line_obj_array;
         std::transform(lines.begin(), lines.end(), std::back_inserter(line_obj_array), [](auto x)
                        { return configor::json::parse(x); });
+        if (get_thread_request_memory_stats() != nullptr)
+        {
+            for (auto &line_obj : line_obj_array)
+            {
+                record_json_nodes(line_obj);
+            }
+        }
+        auto character_width = config.m_data["character"]["width"].as_float();
+        auto character_height = config.m_data["character"]["height"].as_float();
+        point_counts.clear();
+        segment_timings.clear();
 
         for (auto i = 0; i < line_obj_array.size(); ++i)
         {
+            check_cancellation();
             auto line_obj = line_obj_array[i];
             Segment segment;
             segment.set_manager(this);
@@ -153,22 +203,52 @@ public:
             {
                 throw ZeroException();
             }
+            SegmentTimingBuilder timing_builder(i, m_writing_speed_options);
             for (auto item : list)
             {
                 auto x = item["x"].as_float();
                 auto y = item["y"].as_float();
                 auto dx = x - start_x;
                 auto dy = y - start_y;
-                auto dx_resize = (int)(dx * config.m_data["character"]["width"].as_float() / width);
-                auto dy_resize = (int)(dy * config.m_data["character"]["height"].as_float() / height);
+                auto dx_resize = (int)(dx * character_width / width);
+                auto dy_resize = (int)(dy * character_height / height);
                 points.push_back(cv::Point2i(dx_resize, dy_resize));
+                auto time = item["t"];
+                if (time.is_number())
+                {
+                    timing_builder.add(dx / width, dy / height, time.as_float());
+                }
+                else
+                {
+                    timing_builder.add(dx / width, dy / height);
+                }
+            }
+            segment_timings.push_back(timing_builder.get());
+            auto raw_count = (int)points.size();
+            if (m_resample_options.mode != ResampleMode::none)
+            {
+                points = resample_points(points, m_resample_options);
             }
+            point_counts.push_back({i, raw_count, (int)points.size()});
             segment.load_data(points);
             segment.index = i;
             segments.push_back(segment);
         }
         return segments;
     }
+    void set_resample_options(ResampleOptions options)
+    {
+        m_resample_options = options;
+        m_is_standard_cached = false;
+    }
+    /**
+     * @brief 最近一次评测中每个笔画段重采样前后的点数
+     *
+     */
+    std::vector<SegmentPointCount> get_point_counts(bool is_standard)
+    {
+        return is_standard ? m_standard_point_counts : m_evaluate_point_counts;
+    }
     std::vector<Segment> load_from_file(std::string character_file_name, Config config)
     {
 
@@ -199,6 +279,77 @@ public:
             return true;
         }
     }
+    /**
+     * @brief is_stroke_valid的快速版本,结果与is_stroke_valid相同
+     *
+     * 内部像素指4邻域都非零的像素,以内部像素为中心的单位正方形都在所属轮廓之内且互不重叠,
+     * 各轮廓面积截断后之和不小于内部像素数,内部像素达到3个时不提取轮廓直接返回;
+     * 否则(细线、小点或多个小连通域)仍由is_stroke_valid按轮廓计算
+     */
+    bool is_stroke_valid_by_count(const cv::Mat &mat)
+    {
+        if (mat.type() != CV_8UC1)
+        {
+            return is_stroke_valid(mat);
+        }
+        auto interior_count = 0;
+        for (auto y = 1; y + 1 < mat.rows; ++y)
+        {
+            auto row = mat.ptr<uchar>(y);
+            auto row_up = mat.ptr<uchar>(y - 1);
+            auto row_down = mat.ptr<uchar>(y + 1);
+            for (auto x = 1; x + 1 < mat.cols; ++x)
+            {
+                if (row[x] && row[x - 1] && row[x + 1] && row_up[x] && row_down[x])
+                {
+                    ++interior_count;
+                    if (interior_count >= 3)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+        return is_stroke_valid(mat);
+    }
+    /**
+     * @brief 由笔画段折线长度×线宽估计面积,不需要画图
+     *
+     * 只是估计,与is_stroke_valid不一致:单像素宽的细线轮廓面积近于0而长度×线宽可达3以上,判为有效;
+     * 只有一个点或重复点的笔画长度为0,判为无效,画出的点面积可能已不小于3;折返重叠的部分重复计入
+     * 两个方向的不一致数由check输出
+     */
+    bool is_stroke_valid_by_length(const std::vector<cv::Point2i> &points, double stroke_width)
+    {
+        auto length = 0.0;
+        for (auto i = 1; i < points.size(); ++i)
+        {
+            double dx = points[i].x - points[i - 1].x;
+            double dy = points[i].y - points[i - 1].y;
+            length += std::sqrt(dx * dx + dy * dy);
+        }
+        return length * stroke_width >= 3;
+    }
+    std::vector<bool> is_strokes_valid(const std::vector<cv::Mat> &mat_array)
+    {
+        std::vector<bool> result;
+        result.reserve(mat_array.size());
+        for (auto &mat : mat_array)
+        {
+            result.push_back(is_stroke_valid_by_count(mat));
+        }
+        return result;
+    }
+    std::vector<bool> is_strokes_valid(const std::vector<std::vector<cv::Point2i>> &points_array, double stroke_width)
+    {
+        std::vector<bool> result;
+        result.reserve(points_array.size());
+        for (auto &points : points_array)
+        {
+            result.push_back(is_stroke_valid_by_length(points, stroke_width));
+        }
+        return result;
+    }
 
     std::tuple<
         double, 
@@ -208,6 +359,7 @@ public:
         std::unordered_map<std::string, double>, 
         std::unordered_map<std::string, std::vector<std::string>>> score(Stroke standard_stroke, Stroke evaluate_stroke, Config config)
     {
+        StageTimer timer(Stage::stroke_score);
 
         auto total_score_deducted = 0.0;
         std::unordered_map<std::string, std::string> comments;
@@ -240,8 +392,8 @@ public:
         if (std::find(position_name_array.begin(), position_name_array.end(), standard_stroke_name) != position_name_array.end())
         {
 
-            auto standard_rect = get_rect(standard_stroke.draw(character_width, character_height));
-            auto evaluate_rect = get_rect(evaluate_stroke.draw(character_width, character_height));
+            auto standard_rect = get_rect(draw(standard_stroke, DrawLevel::stroke, character_width, character_height));
+            auto evaluate_rect = get_rect(draw(evaluate_stroke, DrawLevel::stroke, character_width, character_height));
 
             if (evaluate_rect.top < standard_rect.top)
             {
@@ -283,7 +435,7 @@ public:
             //            std::string name_evaluate("stroke_angle_evaluate.png");
             //            cv::imwrite(name_evaluate, evaluate_mat);
 
-            auto angle_info = get_angle_info_half(standard_mat, evaluate_mat);
+            auto angle_info = time_stage(Stage::geometry, [&]() { return get_angle_info_half(standard_mat, evaluate_mat); });
             if (angle_info.diff_half_angle < 0)
             {
                 auto [_score, _comment, _value, _sound] = config.get_comment(comment_type, angle_info.diff_half_angle, 1, standard_stroke.order + 1, standard_stroke_name);
@@ -320,8 +472,8 @@ public:
         if (std::find(size_name_array.begin(), size_name_array.end(), standard_stroke_name) != size_name_array.end())
         {
 
-            auto standard_rot_rect = get_min_rect(standard_stroke.draw(character_width, character_height));
-            auto evaluate_rot_rect = get_min_rect(evaluate_stroke.draw(character_width, character_height));
+            auto standard_rot_rect = get_min_rect(draw(standard_stroke, DrawLevel::stroke, character_width, character_height));
+            auto evaluate_rot_rect = get_min_rect(draw(evaluate_stroke, DrawLevel::stroke, character_width, character_height));
             auto standard_size = standard_rot_rect.size;
             auto evaluate_size = evaluate_rot_rect.size;
             auto standard_length = std::max(standard_size.width, standard_size.height);
@@ -358,6 +510,7 @@ public:
                 scores.insert(std::pair(comment_type, 0));
             }
         }
+        record_comments(comments, comments_sound);
         return {total_score_deducted, scores, comments, values, full_scores, comments_sound};
     }
     std::tuple<
@@ -369,6 +522,7 @@ public:
         std::unordered_map<std::string, double>, 
         std::unordered_map<std::string, std::vector<std::string>>> score(Struction standard_struction, Struction evaluate_struction, Config config)
     {
+        StageTimer timer(Stage::struction_score);
 
         auto total_score_deducted = 0.0;
         std::unordered_map<std::string, std::string> comments;
@@ -384,8 +538,15 @@ public:
         auto struction_scale_config = config.m_data["structon_scale"];
         auto struction_size_config = config.m_data["stuction_size"];
         auto struction_angle_config = config.m_data["stuction_angle"];
-        auto [position_info, size_info] = get_position_size_info(standard_struction.draw(character_width, character_height), evaluate_struction.draw(character_width, character_height), character_width, character_height);
-        auto [position_info_rot, size_info_rot] = get_position_size_info_rot(standard_struction.draw(character_width, character_height), evaluate_struction.draw(character_width, character_height), 45, character_width, character_height);
+        //每次几何计算使用新画的标准部件图与测试部件图,画图与几何计算分开计时
+        auto draw_struction_mats = [&]()
+        {
+            return std::make_pair(draw(standard_struction, DrawLevel::struction, character_width, character_height), draw(evaluate_struction, DrawLevel::struction, character_width, character_height));
+        };
+        auto position_mats = time_stage(Stage::draw, draw_struction_mats);
+        auto [position_info, size_info] = time_stage(Stage::geometry, [&]() { return get_position_size_info(position_mats.first, position_mats.second, character_width, character_height); });
+        auto position_rot_mats = time_stage(Stage::draw, draw_struction_mats);
+        auto [position_info_rot, size_info_rot] = time_stage(Stage::geometry, [&]() { return get_position_size_info_rot(position_rot_mats.first, position_rot_mats.second, 45, character_width, character_height); });
         // position
         //实验,要测试得知
         std::string comment_type("struction_position");
@@ -646,7 +807,8 @@ public:
         }
         comment_type = "struction_angle";
         full_scores.insert({comment_type, config.get_full_score(comment_type)});
-        auto [diff_half_angle, diff_angle] = get_angle_info_half(standard_struction.draw(character_width, character_height), evaluate_struction.draw(character_width, character_height));
+        auto angle_mats = time_stage(Stage::draw, draw_struction_mats);
+        auto [diff_half_angle, diff_angle] = time_stage(Stage::geometry, [&]() { return get_angle_info_half(angle_mats.first, angle_mats.second); });
         if (diff_half_angle < 0)
         {
             //设为左
@@ -678,6 +840,7 @@ public:
             scores.insert(std::pair(comment_type, 0));
         }
         double_values.insert(std::pair(comment_type, diff_half_angle));
+        record_comments(comments, comments_sound);
         return {total_score_deducted, scores, comments, values, full_scores, double_values, comments_sound};
     }
 
@@ -687,9 +850,11 @@ public:
         std::unordered_map<std::string, std::string>, 
         std::unordered_map<std::string, int>, 
         std::unordered_map<std::string, double>, 
-        std::unordered_map<std::string, std::vector<std::string>>> score(Character standard_character, Character evaluate_character, std::vector<int> struction_angle_result, std::vector<double> struction_angle_value, Config config)
+        std::unordered_map<std::string, std::vector<std::string>>> score(Character standard_character, Character evaluate_character, std::vector<int> struction_angle_result, std::vector<double> struction_angle_value, Config config, cv::Mat standard_mat = cv::Mat(), cv::Mat evaluate_mat = cv::Mat())
     {
+        StageTimer timer(Stage::character_score);
         // struction_angle_result:结构的评测结果
+        // standard_mat, evaluate_mat:已画好的整字图,为空时在这里画
         //
         auto total_score_deducted = 0.0;
         std::unordered_map<std::string, std::string> comments;
@@ -708,8 +873,16 @@ public:
         auto character_scale_config = config.m_data["character_scale"];
         auto character_size_config = config.m_data["character_size"];
         auto character_angle_config = config.m_data["character_angle"];
-        auto [position_info, size_info] = get_position_size_info(standard_character.draw(character_width, character_height), evaluate_character.draw(character_width, character_height), character_width, character_height);
-        auto [position_info_rot, size_info_rot] = get_position_size_info_rot(standard_character.draw(character_width, character_height), evaluate_character.draw(character_width, character_height), 45, character_width, character_height);
+        if (standard_mat.empty())
+        {
+            standard_mat = draw(standard_character, DrawLevel::character, character_width, character_height);
+        }
+        if (evaluate_mat.empty())
+        {
+            evaluate_mat = draw(evaluate_character, DrawLevel::character, character_width, character_height);
+        }
+        auto [position_info, size_info] = time_stage(Stage::geometry, [&]() { return get_position_size_info(standard_mat, evaluate_mat, character_width, character_height); });
+        auto [position_info_rot, size_info_rot] = time_stage(Stage::geometry, [&]() { return get_position_size_info_rot(standard_mat, evaluate_mat, 45, character_width, character_height); });
         // position
         //实验,要测试得知
         if (size_info.width_ratio * size_info.height_ratio == 0)
@@ -1011,7 +1184,7 @@ public:
             //独体
             //上下/左右半部分角度判断是否角度倾斜
             //调用部件评测函数
-            auto [diff_half_angle, diff_angle] = get_angle_info_half(standard_character.draw(character_width, character_height), evaluate_character.draw(character_width, character_height));
+            auto [diff_half_angle, diff_angle] = time_stage(Stage::geometry, [&]() { return get_angle_info_half(standard_mat, evaluate_mat); });
             if (diff_half_angle < 0)
             {
                 //设为左
@@ -1139,10 +1312,10 @@ public:
                 auto right_standard_character_struction = standard_character_structions[1];
                 auto left_evaluate_character_struction = evaluate_character_structions[0];
                 auto right_evaluate_charcter_struction = evaluate_character_structions[1];
-                auto left_standard_struction_rect = get_rect(left_standard_character_struction.draw(character_width, character_height));
-                auto right_standard_struction_rect = get_rect(right_standard_character_struction.draw(character_width, character_height));
-                auto left_evaluate_struction_rect = get_rect(left_evaluate_character_struction.draw(character_width, character_height));
-                auto right_evaluate_struction_rect = get_rect(right_evaluate_charcter_struction.draw(character_width, character_height));
+                auto left_standard_struction_rect = get_rect(draw(left_standard_character_struction, DrawLevel::struction, character_width, character_height));
+                auto right_standard_struction_rect = get_rect(draw(right_standard_character_struction, DrawLevel::struction, character_width, character_height));
+                auto left_evaluate_struction_rect = get_rect(draw(left_evaluate_character_struction, DrawLevel::struction, character_width, character_height));
+                auto right_evaluate_struction_rect = get_rect(draw(right_evaluate_charcter_struction, DrawLevel::struction, character_width, character_height));
                 auto standard_angle = atan2(
                     right_standard_struction_rect.center_y - left_standard_struction_rect.center_y,
                     right_standard_struction_rect.center_x - left_standard_struction_rect.center_x);
@@ -1267,12 +1440,12 @@ public:
                 std::vector<RectInfo> evaluate_struction_rect_array;
                 for (auto struction : standard_character_structions)
                 {
-                    auto rect = get_rect(struction.draw(character_width, character_height));
+                    auto rect = get_rect(draw(struction, DrawLevel::struction, character_width, character_height));
                     standard_struction_rect_array.push_back(rect);
                 }
                 for (auto struction : evaluate_character_structions)
                 {
-                    auto rect = get_rect(struction.draw(character_width, character_height));
+                    auto rect = get_rect(draw(struction, DrawLevel::struction, character_width, character_height));
                     evaluate_struction_rect_array.push_back(rect);
                 }
                 auto standard_angle_01 = atan2(
@@ -1567,6 +1740,7 @@ public:
             break;
         }
         }
+        record_comments(comments, comments_sound);
         return {total_score_deducted, scores, comments, values, full_scores, comments_sound};
     }
 
@@ -1610,6 +1784,7 @@ public:
         
     )
     {
+        StageTimer timer(Stage::base_score);
         // is_only_character_right==true, 只有is_character_right结果保留
         std::unordered_map<std::string, std::string> comments;
         std::unordered_map<std::string, std::vector<std::string>> comments_sound;
@@ -1663,7 +1838,6 @@ public:
             comment_type = "stroke_order";
             full_scores.insert({comment_type, config.get_full_score(comment_type)});
             bool is_order_right = true;
-            auto stroke_order_id = -1;
             
             if (stroke_count_diff!=0)
             {
@@ -1702,35 +1876,36 @@ public:
                 //     }
                 // }
                 
-                for (auto evaluate_stroke_info: evaluate_stroke_info_array)
+                //写错位置的笔画都报告,只扣一次分
+                auto diagnosis = diagnose_stroke_order(evaluate_stroke_info_array);
+                std::vector<std::string> order_comments;
+                std::vector<std::string> order_sounds;
+                auto order_score = 0.0;
+                auto order_value = 0;
+                for (auto misplaced_index : diagnosis.misplaced_index_array)
                 {
-                    if (evaluate_stroke_info.is_skip)
-                    {
-                        is_order_right = true;
-                        break;
-                    }
-                
-                    if (evaluate_stroke_info.order!=evaluate_stroke_info.segment_index_array[0])
+                    auto stroke_info = std::find_if(evaluate_stroke_info_array.begin(), evaluate_stroke_info_array.end(), [misplaced_index](auto &x)
+                                                    { return x.order == misplaced_index; });
+                    auto [_score, _comment, _value, _sound] = config.get_comment(comment_type, 1, 1, misplaced_index + 1, stroke_info->name);
+                    if (_value != 0)
                     {
-                        is_order_right = false;
-                        stroke_order_id = evaluate_stroke_info.order;
-                        break;
+                        if (order_value == 0)
+                        {
+                            order_score = _score;
+                            order_value = _value;
+                        }
+                        order_comments.push_back(_comment);
+                        order_sounds.insert(order_sounds.end(), _sound.begin(), _sound.end());
                     }
                 }
-                if (stroke_order_id!=-1)
+                if (order_value != 0)
                 {
-                    auto stroke_info = evaluate_stroke_info_array[stroke_order_id];
-                    auto [_score, _comment, _value, _sound] = config.get_comment(comment_type, 1, 1, stroke_order_id + 1, stroke_info.name);
-                    if (_value != 0)
-                    {
-                        is_order_right = false;
-                        total_score_deducted += _score;
-
-                        comments.insert(std::pair(comment_type, _comment));
-                        comments_sound.insert(std::pair(comment_type, _sound));
-                        values.insert(std::pair(comment_type, _value));
-                        scores.insert(std::pair(comment_type, _score));
-                    }
+                    is_order_right = false;
+                    total_score_deducted += order_score;
+                    comments.insert(std::pair(comment_type, merge_string_vector(order_comments, std::string("，"))));
+                    comments_sound.insert(std::pair(comment_type, order_sounds));
+                    values.insert(std::pair(comment_type, order_value));
+                    scores.insert(std::pair(comment_type, order_score));
                 }
             }
             
@@ -1745,12 +1920,32 @@ public:
         }
 
         //书写速度
-        //暂时不做
+        //只在笔画段带时间戳且配置了书写速度时评分
         comment_type = "writing_speed";
-
-        // for (auto stroke : evaluate_all_strokes_sorted_by_order)
-        // {
-        // }
+        if (m_writing_speed_stats.has_time && !config.m_data[comment_type].is_null())
+        {
+            full_scores.insert({comment_type, config.get_full_score(comment_type)});
+            // 1:平均每段用时(秒),2:停顿与抬笔占总时长的比例
+            auto [_score, _comment, _value, _sound] = config.get_comment(comment_type, m_writing_speed_stats.mean_segment_time / 1000, 1, 0);
+            if (_value == 0)
+            {
+                std::tie(_score, _comment, _value, _sound) = config.get_comment(comment_type, m_writing_speed_stats.get_pause_ratio(), 2, 0);
+            }
+            if (_value != 0)
+            {
+                total_score_deducted += _score;
+                comments.insert(std::pair(comment_type, _comment));
+                comments_sound.insert(std::pair(comment_type, _sound));
+                values.insert(std::pair(comment_type, _value));
+                scores.insert(std::pair(comment_type, _score));
+            }
+            else
+            {
+                comments.insert(std::pair(comment_type, ""));
+                values.insert(std::pair(comment_type, 0));
+                scores.insert(std::pair(comment_type, 0));
+            }
+        }
         //错别字
         comment_type = "incorrect_character";
         full_scores.insert({comment_type, config.get_full_score(comment_type)});
@@ -1772,8 +1967,673 @@ public:
             values.insert(std::pair(comment_type, 0));
             scores.insert(std::pair(comment_type, 0));
         }
+        record_comments(comments, comments_sound);
         return {total_score_deducted, scores, comments, values, full_scores, comments_sound};
     }
+    /**
+     * @brief 在读取与画图之前,根据输入确定各层级是否参与评分
+     *
+     * 笔画数不一致时笔画与部件扣分不计入;没有部件信息时只有整字与基础分;
+     * 开启错字快速路径且判为错字时,只保留错字(与书写速度)评分
+     */
+    ScorePlan get_score_plan(
+        const std::vector<std::string> &standard_lines,
+        const std::vector<std::string> &evaluate_lines,
+        const CharacterInfo &char_info,
+        const std::vector<StructionInfo> &struction_info_array,
+        bool is_character_right)
+    {
+        ScorePlan plan;
+        if (standard_lines.size() != evaluate_lines.size())
+        {
+            plan.is_stroke_level = false;
+            plan.is_struction_level = false;
+        }
+        if (struction_info_array.empty() || char_info.struction_index_array.empty())
+        {
+            plan.is_stroke_level = false;
+            plan.is_struction_level = false;
+        }
+        if (!is_character_right && m_is_wrong_character_fast_path)
+        {
+            plan.is_stroke_level = false;
+            plan.is_struction_level = false;
+            plan.is_character_level = false;
+            plan.is_only_character_right_and_speed = true;
+        }
+        return plan;
+    }
+    /**
+     * @brief 错字快速路径开启后,判为错字时不读取笔画段也不画图
+     *
+     */
+    void set_wrong_character_fast_path(bool is_wrong_character_fast_path)
+    {
+        m_is_wrong_character_fast_path = is_wrong_character_fast_path;
+    }
+    /**
+     * @brief 只评错字与书写速度
+     *
+     * @param evaluate_dots resolve_local_inputs已解析的测试字dot,为空时重新读取evaluate_lines
+     */
+    std::tuple<configor::json, std::vector<int>> score_character_right_only(
+        bool is_character_right,
+        std::vector<StrokeInfo> stroke_info_array,
+        std::vector<std::string> standard_lines,
+        std::vector<std::string> evaluate_lines,
+        const std::vector<DotLine> &evaluate_dots = {})
+    {
+        //快速路径不读取笔画段,只为书写速度取时间戳
+        m_writing_speed_stats = summarize_writing_speed(
+            evaluate_dots.size() == evaluate_lines.size() ? get_segment_timings(evaluate_dots) : get_segment_timings(evaluate_lines));
+        auto [base_deduction_score, base_score_items, base_comment_items, base_value_items, base_full_score_items, base_comment_sound_items] = score_base(
+            is_character_right,
+            m_config,
+            stroke_info_array,
+            standard_lines,
+            evaluate_lines,
+            true);
+        auto total_score = 100 * (1 - base_deduction_score * 2);
+        auto [out_json, strokes_indexes] = parse_to_old(
+            total_score,
+            is_character_right,
+            base_score_items,
+            base_comment_items,
+            base_comment_sound_items,
+            base_value_items,
+            base_full_score_items,
+            {},
+            std::unordered_map<std::string, std::string>(),
+            std::unordered_map<std::string, std::vector<std::string>>(),
+            std::unordered_map<std::string, int>(),
+            {},
+            {},
+            std::unordered_map<std::string, std::string>(),
+            std::unordered_map<std::string, std::vector<std::string>>(),
+            std::unordered_map<std::string, int>(),
+            {},
+            {},
+            {},
+            {},
+            {},
+            {});
+        return {out_json, std::vector<int>()};
+    }
+    /**
+     * @brief 读取笔画段,建立笔画与部件映射并画出整字图,详细评测与整体评分共用
+     *
+     * 调用前需已解析配置
+     */
+    void prepare(
+        std::vector<std::string> standard_lines,
+        std::vector<std::string> evaluate_lines,
+        CharacterInfo char_info,
+        std::vector<StructionInfo> struction_info_array,
+        std::vector<StrokeInfo> stroke_info_array)
+    {
+        //字库的重采样设置与本Manager不同时不取用,按自己的设置读取
+        auto reference_entry = m_reference_store && m_store_config_index >= 0 && m_reference_store->get_resample_options() == m_resample_options
+                                   ? m_reference_store->find_entry(m_store_config_index, standard_lines)
+                                   : nullptr;
+        if (reference_entry != nullptr)
+        {
+            m_standard_segments = reference_entry->segments;
+            m_standard_point_counts = reference_entry->point_counts;
+        }
+        else if (m_is_reference_cache && m_is_standard_cached && standard_lines == m_cached_standard_lines)
+        {
+            m_standard_segments = m_cached_standard_segments;
+            m_standard_point_counts = m_cached_standard_point_counts;
+        }
+        else
+        {
+            m_standard_segments = load_from_content(standard_lines, m_config, m_standard_point_counts);
+            if (m_is_reference_cache)
+            {
+                m_cached_standard_lines = standard_lines;
+                m_cached_standard_segments = m_standard_segments;
+                m_cached_standard_point_counts = m_standard_point_counts;
+                m_is_standard_cached = true;
+            }
+        }
+        std::vector<SegmentTiming> segment_timings;
+        m_evaluate_segments = load_from_content(evaluate_lines, m_config, m_evaluate_point_counts, segment_timings);
+        m_writing_speed_stats = summarize_writing_speed(segment_timings);
+        get_stroke_map(m_standard_character, m_standard_segments, char_info, struction_info_array, stroke_info_array, true);
+        get_stroke_map(m_evaluate_character, m_evaluate_segments, char_info, struction_info_array, stroke_info_array, false);
+        auto character_width = m_config.m_data["character"]["width"].as_integer();
+        auto character_height = m_config.m_data["character"]["height"].as_integer();
+        StageTimer timer(Stage::draw);
+        m_standard_mat = draw(m_standard_character, DrawLevel::character, character_width, character_height);
+        m_evaluate_mat = draw(m_evaluate_character, DrawLevel::character, character_width, character_height);
+    }
+    /**
+     * @brief 设置慢请求记录,多个Manager可共用一个;为空时不监测
+     *
+     */
+    void set_slow_request_log(std::shared_ptr<SlowRequestLog> slow_request_log)
+    {
+        m_slow_request_log = slow_request_log;
+    }
+    /**
+     * @brief 执行一次请求:开启轨迹时输出整个请求的事件,开启内存统计时统计到m_memory_stats,
+     * 被抽中监测且耗时超过阈值时把请求写入慢请求记录
+     *
+     * @param make_request 只对被抽中监测的请求在func之前调用,记录的是调用者传入的输入,
+     * 不受func中本地映射、部件划分等对输入的改写影响;未抽中的请求不复制输入
+     */
+    template <typename MakeRequest, typename Func>
+    auto run_request(const char *entry, MakeRequest &&make_request, Func &&func)
+    {
+        TraceScope trace("request", entry);
+        CancellationScope cancellation_scope(m_cancellation_token.get());
+        if (m_is_memory_accounting)
+        {
+            m_memory_stats = RequestMemoryStats();
+        }
+        RequestMemoryScope memory_scope(m_is_memory_accounting ? &m_memory_stats : nullptr);
+        if (!m_slow_request_log || !m_slow_request_log->should_sample())
+        {
+            return func();
+        }
+        auto request = make_request();
+        RequestStageTimes times;
+        RequestStageScope scope(&times);
+        m_standard_point_counts.clear();
+        m_evaluate_point_counts.clear();
+        auto begin = std::chrono::steady_clock::now();
+        auto get_latency = [&]()
+        {
+            return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        };
+        try
+        {
+            auto result = func();
+            auto latency = get_latency();
+            if (m_slow_request_log->is_slow(latency))
+            {
+                m_slow_request_log->capture(entry, request, latency, times, m_standard_point_counts, m_evaluate_point_counts, "");
+            }
+            return result;
+        }
+        catch (const std::exception &e)
+        {
+            auto latency = get_latency();
+            if (m_slow_request_log->is_slow(latency))
+            {
+                m_slow_request_log->capture(entry, request, latency, times, m_standard_point_counts, m_evaluate_point_counts, e.what());
+            }
+            throw;
+        }
+    }
+    void parse_config(std::string config_line)
+    {
+        if (m_reference_store)
+        {
+            auto config_index = m_reference_store->find_config(config_line);
+            if (config_index >= 0)
+            {
+                if (config_index != m_store_config_index)
+                {
+                    clear_reference_cache();
+                    m_config = m_reference_store->get_config(config_index);
+                    m_store_config_index = config_index;
+                }
+                return;
+            }
+            m_store_config_index = -1;
+        }
+        if (m_is_reference_cache && m_is_config_cached && config_line == m_cached_config_line)
+        {
+            return;
+        }
+        //先作废缓存:解析中途抛出异常时m_config已被部分改写,不能再与旧的配置行匹配
+        clear_reference_cache();
+        StageTimer timer(Stage::config_parse);
+        m_config.parse_data_1_0(config_line);
+        record_json_nodes(m_config.m_data);
+        if (m_is_reference_cache)
+        {
+            m_cached_config_line = config_line;
+            m_is_config_cached = true;
+        }
+    }
+    /**
+     * @brief 开启后配置与上次相同时不再解析,标准字与上次相同时不再读取笔画段
+     *
+     * 按参考字分批处理请求的服务中,同一批只解析一次配置、读取一次标准字;默认关闭
+     */
+    void set_reference_cache(bool is_reference_cache)
+    {
+        m_is_reference_cache = is_reference_cache;
+        clear_reference_cache();
+    }
+    /**
+     * @brief 解析配置并读取标准字,加入参考字库;已在字库中的配置与标准字跳过
+     *
+     * 标准字按本Manager的重采样设置读取,字库中已有按其他设置读取的标准字时抛出std::runtime_error
+     */
+    void add_reference(ReferenceStore &store, const std::string &config_line, const std::vector<std::string> &standard_lines)
+    {
+        if (!store.is_compatible(m_resample_options))
+        {
+            throw std::runtime_error("reference store was built with different resample options");
+        }
+        auto config_index = store.find_config(config_line);
+        if (config_index < 0)
+        {
+            StageTimer timer(Stage::config_parse);
+            Config config;
+            config.parse_data_1_0(config_line);
+            config_index = store.add_config(config_line, config);
+        }
+        if (store.find_entry(config_index, standard_lines) == nullptr)
+        {
+            ReferenceEntry entry;
+            entry.segments = load_from_content(standard_lines, store.get_config(config_index), entry.point_counts);
+            store.add_entry(config_index, standard_lines, entry, m_resample_options);
+        }
+    }
+    /**
+     * @brief 设置只读参考字库,配置与标准字在字库中时直接取用,不再解析与读取;为空时不使用
+     *
+     * 多个Manager以及fork出的工作进程可共用一个字库
+     */
+    void set_reference_store(std::shared_ptr<const ReferenceStore> store)
+    {
+        m_reference_store = store;
+        m_store_config_index = -1;
+    }
+    /**
+     * @brief 设置之后各次评测的取消标志,在各阶段开始与逐笔画段、逐行匹配时检查;为空时不检查
+     *
+     * 超时后score(...)与evaluate返回降级结果,double score(...)抛出DeadlineException
+     */
+    void set_cancellation_token(std::shared_ptr<CancellationToken> token)
+    {
+        m_cancellation_token = token;
+    }
+    void clear_reference_cache()
+    {
+        m_is_config_cached = false;
+        m_is_standard_cached = false;
+        m_cached_config_line.clear();
+        m_cached_standard_lines.clear();
+        m_cached_standard_segments.clear();
+        m_cached_standard_point_counts.clear();
+    }
+    /**
+     * @brief 开启后每次请求统计Mat分配、各层级画图次数、json节点数与评语字节数
+     *
+     * 统计结果由get_memory_stats取得,详细评测结果中另附debug.memory
+     */
+    void set_memory_accounting(bool is_memory_accounting)
+    {
+        if (is_memory_accounting)
+        {
+            CountingMatAllocator::install();
+        }
+        m_is_memory_accounting = is_memory_accounting;
+    }
+    /**
+     * @brief 开启后cv::Mat的数据按大小在线程内复用,稳定后画图与凸包对齐不再申请内存
+     *
+     * 对整个进程生效,与set_memory_accounting可同时开启
+     */
+    void set_mat_pool(bool is_mat_pool)
+    {
+        if (is_mat_pool)
+        {
+            MatPoolAllocator::install();
+        }
+        MatPoolAllocator::set_enabled(is_mat_pool);
+    }
+    /**
+     * @brief 整体评分中凸包缩放后的重叠得分改为在多分辨率上搜索最佳缩放与平移后的得分
+     *
+     * 默认关闭,关闭时与原方案一致
+     */
+    void set_alignment_search(bool is_alignment_search, AlignmentSearchOptions options = AlignmentSearchOptions())
+    {
+        m_is_alignment_search = is_alignment_search;
+        m_alignment_search_options = options;
+    }
+    //最近一次整体评分的搜索结果,包括最佳得分与对应的变换
+    AlignmentResult get_alignment_result()
+    {
+        return m_alignment_result;
+    }
+    /**
+     * @brief 在本地求笔画段与标准字笔画的映射,输出与网络端相同格式的StrokeInfo
+     *
+     * @param stroke_info_array 只取其中按order对应的笔画名与is_valid,可为空
+     */
+    std::vector<StrokeInfo> map_strokes(
+        const std::vector<std::string> &standard_lines,
+        const std::vector<std::string> &evaluate_lines,
+        const std::vector<StrokeInfo> &stroke_info_array)
+    {
+        return map_strokes(get_standard_dots(standard_lines), parse_dot_lines(evaluate_lines), stroke_info_array);
+    }
+    std::vector<StrokeInfo> map_strokes(
+        const std::vector<DotLine> &standard_dots,
+        const std::vector<DotLine> &evaluate_dots,
+        const std::vector<StrokeInfo> &stroke_info_array)
+    {
+        StageTimer timer(Stage::stroke_match);
+        std::vector<std::string> stroke_names(standard_dots.size());
+        std::vector<bool> is_valid_array(standard_dots.size(), true);
+        for (auto &stroke_info : stroke_info_array)
+        {
+            if (stroke_info.order >= 0 && stroke_info.order < stroke_names.size())
+            {
+                stroke_names[stroke_info.order] = stroke_info.name;
+                is_valid_array[stroke_info.order] = stroke_info.is_valid;
+            }
+        }
+        auto result = StrokeMapper(m_stroke_mapper_options).map(standard_dots, evaluate_dots, stroke_names);
+        for (auto &stroke_info : result)
+        {
+            stroke_info.is_valid = is_valid_array[stroke_info.order];
+        }
+        return result;
+    }
+    /**
+     * @brief 开启后忽略传入的笔画映射,由map_strokes在本地求得,不再依赖网络端
+     *
+     * 默认关闭
+     */
+    void set_local_stroke_map(bool is_local_stroke_map, StrokeMapperOptions options = StrokeMapperOptions())
+    {
+        m_is_local_stroke_map = is_local_stroke_map;
+        m_stroke_mapper_options = options;
+    }
+    /**
+     * @brief 本地错字预判,只比较几何形状,结果为unknown时才需要远端识别
+     *
+     * 标准字的形状描述按标准字缓存,同一标准字的请求只求一次
+     */
+    CharacterCheckResult check_character(const std::vector<std::string> &standard_lines, const std::vector<std::string> &evaluate_lines)
+    {
+        auto &standard_dots = get_standard_dots(standard_lines);
+        return check_character(standard_dots, parse_dot_lines(evaluate_lines));
+    }
+    //standard_dots须为get_standard_dots的结果,形状描述随它缓存
+    CharacterCheckResult check_character(const std::vector<DotLine> &standard_dots, const std::vector<DotLine> &evaluate_dots)
+    {
+        StageTimer timer(Stage::character_check);
+        CharacterVerifier verifier(m_character_verifier_options);
+        if (!m_is_standard_shape_cached)
+        {
+            m_standard_shape = verifier.get_shape(standard_dots);
+            m_is_standard_shape_cached = true;
+        }
+        return verifier.check(m_standard_shape, verifier.get_shape(evaluate_dots));
+    }
+    /**
+     * @brief 标准字各行解析后的dot,按标准字缓存,本地映射、部件划分与错字预判共用
+     *
+     * 标准字改变时同时作废标准字形状的缓存
+     */
+    const std::vector<DotLine> &get_standard_dots(const std::vector<std::string> &standard_lines)
+    {
+        if (!m_is_standard_dots_cached || standard_lines != m_dots_standard_lines)
+        {
+            m_standard_dots = parse_dot_lines(standard_lines);
+            m_dots_standard_lines = standard_lines;
+            m_is_standard_dots_cached = true;
+            m_is_standard_shape_cached = false;
+        }
+        return m_standard_dots;
+    }
+    /**
+     * @brief 开启后每次请求先做本地错字预判,结果由get_character_check_result取得
+     *
+     * 默认关闭;options.is_override_verdict为true时判为right或wrong才覆盖传入的is_character_right,
+     * 否则传入值不变,预判只供调用方决定是否需要远端识别
+     */
+    void set_local_character_check(bool is_local_character_check, CharacterVerifierOptions options = CharacterVerifierOptions())
+    {
+        m_is_local_character_check = is_local_character_check;
+        m_character_verifier_options = options;
+        m_is_standard_shape_cached = false;
+    }
+    //最近一次请求的本地错字预判,未开启时为unknown
+    CharacterCheckResult get_character_check_result()
+    {
+        return m_character_check_result;
+    }
+    /**
+     * @brief 按开启的本地功能替换网络端提供的输入:笔画映射、部件划分与是否写对
+     *
+     * @param is_check_character 整体评分与是否写对无关,为false时不做错字预判
+     * @param evaluate_dots 用到测试字时输出解析后的dot,供快速路径的书写速度复用,否则为空
+     * 每行dot只解析一次:标准字按标准字缓存,测试字按请求解析
+     */
+    void resolve_local_inputs(
+        const std::vector<std::string> &standard_lines,
+        const std::vector<std::string> &evaluate_lines,
+        CharacterInfo &char_info,
+        std::vector<StructionInfo> &struction_info_array,
+        std::vector<StrokeInfo> &stroke_info_array,
+        bool &is_character_right,
+        bool is_check_character = true,
+        std::vector<DotLine> *evaluate_dots = nullptr)
+    {
+        auto is_check = m_is_local_character_check && is_check_character;
+        std::vector<DotLine> dots;
+        if (m_is_local_stroke_map || is_check)
+        {
+            dots = parse_dot_lines(evaluate_lines);
+        }
+        if (m_is_local_stroke_map)
+        {
+            //传入的部件序号是传入映射中未跳过笔画的序号,换算到本地映射,未写的笔画从部件中去掉
+            auto previous_orders = get_struction_stroke_orders(stroke_info_array, standard_lines.size());
+            stroke_info_array = map_strokes(get_standard_dots(standard_lines), dots, stroke_info_array);
+            remap_struction_strokes(struction_info_array, char_info, previous_orders, stroke_info_array);
+        }
+        if (m_is_local_struction && (struction_info_array.empty() || char_info.struction_index_array.empty()))
+        {
+            struction_info_array = group_structions(get_standard_dots(standard_lines), stroke_info_array, char_info.type);
+            char_info.struction_index_array.clear();
+            for (auto i = 0; i < struction_info_array.size(); ++i)
+            {
+                char_info.struction_index_array.push_back(i);
+            }
+        }
+        m_character_check_result = CharacterCheckResult();
+        if (is_check)
+        {
+            m_character_check_result = check_character(get_standard_dots(standard_lines), dots);
+            if (m_character_verifier_options.is_override_verdict && m_character_check_result.check != CharacterCheck::unknown)
+            {
+                is_character_right = m_character_check_result.check == CharacterCheck::right;
+            }
+        }
+        if (evaluate_dots != nullptr)
+        {
+            *evaluate_dots = std::move(dots);
+        }
+    }
+    /**
+     * @brief 按结构类型在本地划分部件,输出与传入的StructionInfo相同的格式
+     *
+     */
+    std::vector<StructionInfo> group_structions(
+        const std::vector<std::string> &standard_lines,
+        const std::vector<StrokeInfo> &stroke_info_array,
+        const std::string &layout)
+    {
+        return group_structions(get_standard_dots(standard_lines), stroke_info_array, layout);
+    }
+    std::vector<StructionInfo> group_structions(
+        const std::vector<DotLine> &standard_dots,
+        const std::vector<StrokeInfo> &stroke_info_array,
+        const std::string &layout)
+    {
+        StageTimer timer(Stage::struction_group);
+        return StructionGrouper(m_struction_grouper_options).group(standard_dots, stroke_info_array, layout);
+    }
+    /**
+     * @brief 开启后没有传入部件信息时由group_structions在本地划分,部件层级始终参与评分
+     *
+     * 默认关闭,关闭时没有部件信息只有整字与基础分
+     */
+    void set_local_struction(bool is_local_struction, StructionGrouperOptions options = StructionGrouperOptions())
+    {
+        m_is_local_struction = is_local_struction;
+        m_struction_grouper_options = options;
+    }
+    /**
+     * @brief 只读取笔画段的时间戳,不重采样也不建立Segment
+     *
+     */
+    std::vector<SegmentTiming> get_segment_timings(const std::vector<std::string> &lines)
+    {
+        std::vector<SegmentTiming> segment_timings;
+        for (auto i = 0; i < lines.size(); ++i)
+        {
+            auto line_obj = configor::json::parse(lines[i]);
+            auto start_x = line_obj["startX"].as_float();
+            auto start_y = line_obj["startY"].as_float();
+            auto width = line_obj["endX"].as_float() - start_x;
+            auto height = line_obj["endY"].as_float() - start_y;
+            if (width == 0 || height == 0)
+            {
+                throw ZeroException();
+            }
+            SegmentTimingBuilder timing_builder(i, m_writing_speed_options);
+            for (auto item : line_obj["list"])
+            {
+                auto time = item["t"];
+                if (time.is_number())
+                {
+                    timing_builder.add((item["x"].as_float() - start_x) / width, (item["y"].as_float() - start_y) / height, time.as_float());
+                }
+                else
+                {
+                    timing_builder.add((item["x"].as_float() - start_x) / width, (item["y"].as_float() - start_y) / height);
+                }
+            }
+            segment_timings.push_back(timing_builder.get());
+        }
+        return segment_timings;
+    }
+    //使用已解析的dot,与上面逐行读取的结果相同
+    std::vector<SegmentTiming> get_segment_timings(const std::vector<DotLine> &dot_lines)
+    {
+        std::vector<SegmentTiming> segment_timings;
+        for (auto i = 0; i < dot_lines.size(); ++i)
+        {
+            if (!dot_lines[i].has_area)
+            {
+                throw ZeroException();
+            }
+            SegmentTimingBuilder timing_builder(i, m_writing_speed_options);
+            for (auto j = 0; j < dot_lines[i].points.size(); ++j)
+            {
+                auto &point = dot_lines[i].points[j];
+                auto time = dot_lines[i].times[j];
+                if (std::isnan(time))
+                {
+                    timing_builder.add(point.x, point.y);
+                }
+                else
+                {
+                    timing_builder.add(point.x, point.y, time);
+                }
+            }
+            segment_timings.push_back(timing_builder.get());
+        }
+        return segment_timings;
+    }
+    void set_writing_speed_options(WritingSpeedOptions options)
+    {
+        m_writing_speed_options = options;
+    }
+    //最近一次请求测试字的书写速度统计
+    WritingSpeedStats get_writing_speed_stats()
+    {
+        return m_writing_speed_stats;
+    }
+    //最近一次请求的内存统计
+    RequestMemoryStats get_memory_stats()
+    {
+        return m_memory_stats;
+    }
+    //画图并计数
+    template <typename Drawable>
+    cv::Mat draw(Drawable &&item, DrawLevel level, int width, int height)
+    {
+        record_draw(level);
+        return item.draw(width, height);
+    }
+    /**
+     * @brief 一次解析、映射、画图,按flags同时得到详细评测结果与整体评分
+     *
+     * @param flags EVALUATE_DETAIL, EVALUATE_HOLISTIC的组合
+     */
+    EvaluateResult evaluate(ScoreRequest request, int flags = EVALUATE_DETAIL | EVALUATE_HOLISTIC)
+    {
+        auto result = run_request("evaluate", [&]()
+                                  { return request; },
+                                  [&]()
+                                  { return evaluate_unmonitored(request, flags); });
+        if (m_is_memory_accounting && result.has_detail)
+        {
+            result.detail["debug"]["memory"] = m_memory_stats.to_json();
+        }
+        return result;
+    }
+    EvaluateResult evaluate_unmonitored(ScoreRequest request, int flags)
+    {
+        EvaluateResult result;
+        try
+        {
+            evaluate_stages(request, flags, result);
+        }
+        catch (const DeadlineException &)
+        {
+            //整体评分已算出时映射到旧格式,否则返回默认结果;均带DEADLINE_EXCEEDED_ERROR
+            result.is_degraded = true;
+            if ((flags & EVALUATE_DETAIL) != 0)
+            {
+                std::tie(result.detail, result.red_index_array) = get_deadline_result(result.has_holistic, result.holistic_score);
+                result.has_detail = true;
+            }
+        }
+        return result;
+    }
+    void evaluate_stages(ScoreRequest &request, int flags, EvaluateResult &result)
+    {
+        std::vector<DotLine> evaluate_dots;
+        resolve_local_inputs(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.is_character_right, true, &evaluate_dots);
+        auto is_detail = (flags & EVALUATE_DETAIL) != 0;
+        auto is_holistic = (flags & EVALUATE_HOLISTIC) != 0;
+        auto plan = get_score_plan(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.is_character_right);
+        parse_config(request.config_line);
+        if (is_detail && plan.is_only_character_right_and_speed)
+        {
+            std::tie(result.detail, result.red_index_array) = score_character_right_only(request.is_character_right, request.stroke_info_array, request.standard_lines, request.evaluate_lines, evaluate_dots);
+            result.has_detail = true;
+            if (!is_holistic)
+            {
+                return;
+            }
+        }
+        prepare(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array);
+        if (is_holistic)
+        {
+            result.holistic_score = score_holistic(request.char_info);
+            result.has_holistic = true;
+        }
+        if (is_detail && !result.has_detail)
+        {
+            std::tie(result.detail, result.red_index_array) = score_detail(plan, request.standard_lines, request.evaluate_lines, request.stroke_info_array, request.is_character_right);
+            result.has_detail = true;
+        }
+    }
     /**
      * @brief 判断笔画个数是否正确
      * 
@@ -1801,16 +2661,53 @@ public:
     {
         //如果笔画数目不正确,扣掉部件和笔画分数,只保留整体分数
         //如果笔顺数目不正确,因不影响部件切分,保留部件分和笔画分,扣除笔顺分
-        //如果写错字了,目前正常打分,看效果
-        m_config.parse_data_1_0(config_line);
-        m_standard_segments = load_from_content(standard_lines, m_config);
-        m_evaluate_segments = load_from_content(evaluate_lines, m_config);
-        get_stroke_map(m_standard_character, m_standard_segments, char_info, struction_info_array, stroke_info_array, true);
-        get_stroke_map(m_evaluate_character, m_evaluate_segments, char_info, struction_info_array, stroke_info_array, false);
+        //如果写错字了,目前正常打分,看效果;set_wrong_character_fast_path(true)时只扣错字分
+        //在画图之前先确定参与评分的层级,不参与的层级不画图
+        auto make_request = [&]()
+        {
+            return ScoreRequest{standard_lines, evaluate_lines, char_info, struction_info_array, stroke_info_array, config_line, is_character_right};
+        };
+        //超过截止时间或被取消时返回默认结果,error为DEADLINE_EXCEEDED_ERROR
+        auto result = run_request("score", make_request, [&]()
+                                  {
+                                      try
+                                      {
+                                          std::vector<DotLine> evaluate_dots;
+                                          resolve_local_inputs(standard_lines, evaluate_lines, char_info, struction_info_array, stroke_info_array, is_character_right, true, &evaluate_dots);
+                                          auto plan = get_score_plan(standard_lines, evaluate_lines, char_info, struction_info_array, is_character_right);
+                                          parse_config(config_line);
+                                          if (plan.is_only_character_right_and_speed)
+                                          {
+                                              return score_character_right_only(is_character_right, stroke_info_array, standard_lines, evaluate_lines, evaluate_dots);
+                                          }
+                                          prepare(standard_lines, evaluate_lines, char_info, struction_info_array, stroke_info_array);
+                                          return score_detail(plan, standard_lines, evaluate_lines, stroke_info_array, is_character_right);
+                                      }
+                                      catch (const DeadlineException &)
+                                      {
+                                          return get_deadline_result(false, 0.0);
+                                      } });
+        if (m_is_memory_accounting)
+        {
+            std::get<0>(result)["debug"]["memory"] = m_memory_stats.to_json();
+        }
+        return result;
+    }
+    /**
+     * @brief 在prepare之后计算详细评测结果
+     *
+     */
+    std::tuple<configor::json, std::vector<int>> score_detail(
+        ScorePlan plan,
+        std::vector<std::string> standard_lines,
+        std::vector<std::string> evaluate_lines,
+        std::vector<StrokeInfo> stroke_info_array,
+        bool is_character_right)
+    {
         auto standard_all_strokes_sorted_by_order = get_all_strokes(m_standard_character);
         std::vector<Stroke> evaluate_all_strokes_sorted_by_order;
         configor::json result;
-        if (!m_evaluate_character.m_structions.empty())
+        if (plan.is_stroke_level && plan.is_struction_level)
         {
             evaluate_all_strokes_sorted_by_order = get_all_strokes(m_evaluate_character);
             std::vector<std::unordered_map<std::string, std::string>> all_strokes_comments;
@@ -1826,7 +2723,8 @@ public:
                      evaluate_stroke_iter != evaluate_all_strokes_sorted_by_order.end();
                 ++standard_stroke_iter, ++evaluate_stroke_iter)
             {
-
+                TraceScope trace("stroke", [&]()
+                                 { return "stroke " + std::to_string(standard_stroke_iter->order) + " " + standard_stroke_iter->name; });
                 auto [stroke_score, stroke_score_items, stroke_comment_items, stroke_value_items, stroke_full_score_items, stroke_comments_sound_items] = score(*standard_stroke_iter, *evaluate_stroke_iter, m_config);
                 strokes_deduction_score += stroke_score;
 
@@ -1856,6 +2754,8 @@ public:
                      evaluate_struction_iter != evaluate_structions.end();
                 ++standard_struction_iter, ++evaluate_struction_iter)
             {
+                TraceScope trace("struction", [&]()
+                                 { return "struction " + std::to_string(standard_struction_iter - standard_structions.begin()) + " " + m_standard_character.type; });
                 auto [struction_score, struction_score_items, struction_comment_items, struction_value_items, struction_full_score_items, struction_double_value_items, struction_comment_sound_items] = score(*standard_struction_iter, *evaluate_struction_iter, m_config);
                 struction_deduction_score += struction_score;
                 all_struction_comments.push_back(struction_comment_items);
@@ -1882,7 +2782,7 @@ public:
             std::transform(all_struction_double_values.begin(), all_struction_double_values.end(), std::back_inserter(struction_angle_value_array), [](auto x)
                            { return x["struction_angle"]; });
             auto segment_indexes = get_struction_segments_index(evaluate_structions[struction_index]);
-            auto [character_deduction_score, character_score_items, character_comment_items, character_value_items, character_full_score_items, character_comment_sound_items] = score(m_standard_character, m_evaluate_character, struction_angle_result_array, struction_angle_value_array, m_config);
+            auto [character_deduction_score, character_score_items, character_comment_items, character_value_items, character_full_score_items, character_comment_sound_items] = score(m_standard_character, m_evaluate_character, struction_angle_result_array, struction_angle_value_array, m_config, m_standard_mat, m_evaluate_mat);
             auto [base_deduction_score, base_score_items, base_comment_items, base_value_items, base_full_score_items, base_comment_sound_items] = score_base(
                 is_character_right, 
                 m_config, 
@@ -1929,7 +2829,10 @@ public:
         }
         else
         {
-            auto [character_deduction_score, character_score_items, character_comment_items, character_value_items, character_full_score_items, character_comment_sound_items] = score(m_standard_character, m_evaluate_character, {}, {}, m_config);
+            //笔画数不一致时部件与笔画对应不上,整字层级按无部件处理
+            auto evaluate_character_without_struction = m_evaluate_character;
+            evaluate_character_without_struction.m_structions.clear();
+            auto [character_deduction_score, character_score_items, character_comment_items, character_value_items, character_full_score_items, character_comment_sound_items] = score(m_standard_character, evaluate_character_without_struction, {}, {}, m_config, m_standard_mat, m_evaluate_mat);
             auto [base_deduction_score, base_score_items, base_comment_items, base_value_items, base_full_score_items, base_comment_sound_items] = score_base(
                 //standard_all_strokes_sorted_by_order, 
                 //evaluate_all_strokes_sorted_by_order, 
@@ -2001,6 +2904,7 @@ public:
         std::vector<std::unordered_map<std::string, int>> stroke_value_items_array,
         std::vector<std::unordered_map<std::string, double>> stroke_full_score_items_array)
     {
+        StageTimer timer(Stage::parse_to_old);
         auto centerOfGravityType = 0;
         auto character_position_value = character_value_items["character_position"];
         switch (character_position_value)
@@ -2332,6 +3236,19 @@ public:
         auto z105spacingStructureSound = spacing_struction_comments_sound;
         
         auto z100speedScore = 100;
+        std::string speed("");
+        std::vector<std::string> z109speedSound;
+        if (base_score_items.find("writing_speed") != base_score_items.end())
+        {
+            speed = base_comment_items["writing_speed"];
+            z109speedSound.insert(
+                z109speedSound.end(),
+                base_comment_sound_items["writing_speed"].begin(),
+                base_comment_sound_items["writing_speed"].end());
+            auto writing_speed_score = base_score_items["writing_speed"];
+            auto writing_speed_full_score = base_full_score_items["writing_speed"];
+            z100speedScore = (int)(100 * (writing_speed_full_score - writing_speed_score) / writing_speed_full_score);
+        }
 
         double total_struction_full_score = 0.0;
         std::vector struction_keys{"struction_position", "struction_angle", "struction_size", "struction_scale"};
@@ -2410,6 +3327,7 @@ public:
         res["strokeLengthScore"] = strokeLengthScore;
         res["strokeOrder"] = strokeOrder==""?"正确":strokeOrder;
         res["strokeOrderScore"] = strokeOrderScore;
+        res["speed"] = speed==""?"正确":speed;
         res["z100speedScore"] = z100speedScore;
         res["z102struction"] = z102struction==""?"正确":z102struction;
         res["z101structionScore"] = z101structionScore;
@@ -2419,6 +3337,8 @@ public:
         res["z106strokeLengthSound"] = z106strokeLengthSound;
         res["z107structionSound"] = z107structionSound;
         res["z108incorrectCharacterSound"] = z108incorrectCharacterSound;
+        res["z109speedSound"] = z109speedSound;
+        record_json_nodes(res);
         return std::make_tuple(res, stroke_red_index_array);
     }
     std::tuple<configor::json, std::vector<int>> default_old_result()
@@ -2442,6 +3362,7 @@ public:
         res["strokeLengthScore"] = 0;
         res["strokeOrder"] = "";
         res["strokeOrderScore"] = 0;
+        res["speed"] = "";
         res["z100speedScore"] = 0;
         res["z102struction"] = "";
         res["z101structionScore"] = 0;
@@ -2451,10 +3372,41 @@ public:
         res["z106strokeLengthSound"] = std::vector<std::string>();
         res["z107structionSound"] = std::vector<std::string>();
         res["z108incorrectCharacterSound"] = std::vector<std::string>();
+        res["z109speedSound"] = std::vector<std::string>();
         return std::make_tuple(res, std::vector<int>());
     }
 
+    /**
+     * @brief 超过截止时间或被取消时的详细评测结果:default_old_result()的error为DEADLINE_EXCEEDED_ERROR
+     *
+     * @param has_holistic 整体评分已算出时score取整体评分的百分制
+     */
+    std::tuple<configor::json, std::vector<int>> get_deadline_result(bool has_holistic, double holistic_score)
+    {
+        auto [res, red_index_array] = default_old_result();
+        res["error"] = DEADLINE_EXCEEDED_ERROR;
+        if (has_holistic)
+        {
+            res["score"] = (int)(100 * holistic_score);
+        }
+        return std::make_tuple(res, red_index_array);
+    }
     double get_real_deduction(int diff_x, int width, int diff_y, int height)
+    {
+        return get_real_deduction_impl(diff_x, width, diff_y, height);
+    }
+    /**
+     * @brief 以半个画布为基准计算位移扣分,与get_real_deduction(diff_x, width / 2, diff_y, height / 2)一致
+     *
+     * @param size 画布尺寸,特化尺寸下除数为编译期常量
+     */
+    template <typename CanvasSizeT>
+    double get_real_deduction(int diff_x, int diff_y, CanvasSizeT size)
+    {
+        return get_real_deduction_impl(diff_x, size.half_width(), diff_y, size.half_height());
+    }
+    template <typename Width, typename Height>
+    double get_real_deduction_impl(int diff_x, Width width, int diff_y, Height height)
     {
         if (height * width == 0)
         {
@@ -2495,6 +3447,75 @@ public:
         }
         return 1 - deduction;
     }
+    /**
+     * @brief 凸包中心对齐后的重叠得分
+     *
+     * @param size 画布尺寸,由dispatch_canvas_size选择特化版本
+     * @param is_resized 是否再按面积比缩放后求一次得分
+     * @return 中心对齐得分, 中心对齐并缩放后的得分(is_resized==false时为0), 凸包中心差
+     */
+    template <typename CanvasSizeT>
+    auto get_convexhull_score(cv::Mat standard_mat, cv::Mat evaluate_mat, CanvasSizeT size, bool is_resized)
+    {
+        //中心仍由ConvexHull求得,与原评分一致;ConvexHull不提供顶点,填充用的顶点另由get_hull_points求得
+        auto standard_center = ConvexHull(standard_mat).get_center();
+        auto evaluate_center = ConvexHull(evaluate_mat).get_center();
+        auto standard_hull = get_hull_points(standard_mat);
+        auto evaluate_hull = get_hull_points(evaluate_mat);
+        //凸包中心对齐
+        //只对凸包顶点做平移与缩放,再在2倍画布上重新填充,不对整张图做warpAffine
+        // 1.图片放大2倍,原图放在中间
+        auto extend_type = 2 * standard_mat.type();
+        cv::Point2d extend_offset(size.half_width(), size.half_height());
+        cv::Mat standard_extend_mat = cv::Mat::zeros(size.extend_width(), size.extend_height(), extend_type);
+        record_draw(DrawLevel::convexhull);
+        fill_hull(standard_extend_mat, standard_hull, 1.0, extend_offset);
+        // 2.中心对齐
+        auto diff_center = standard_center - evaluate_center;
+        cv::Point2d translated_offset(extend_offset.x + diff_center.x, extend_offset.y + diff_center.y);
+        cv::Mat evaluate_convexhull_mat_translated = cv::Mat::zeros(size.extend_width(), size.extend_height(), extend_type);
+        record_draw(DrawLevel::convexhull);
+        fill_hull(evaluate_convexhull_mat_translated, evaluate_hull, 1.0, translated_offset);
+
+        auto [intersection_sum, union_sum] = get_overlap_sum(standard_extend_mat, evaluate_convexhull_mat_translated, size);
+        auto convexhull_score = intersection_sum / union_sum;
+        auto convexhull_score_resized = 0.0;
+        if (!is_resized)
+        {
+            return std::make_tuple(convexhull_score, convexhull_score_resized, diff_center);
+        }
+
+        // 3.求evaluate_extend_mat的面积,并以标准字凸包中心为不动点放大到与standard_extend_mat一致
+        auto area_standard_convexhull = cv::sum(standard_extend_mat);
+        auto area_evaluate_convexhull = cv::sum(evaluate_convexhull_mat_translated);
+        auto area_ratio = area_standard_convexhull[0] / area_evaluate_convexhull[0];
+        auto length_ratio = sqrt(area_ratio);
+        // p' = center + length_ratio * (p + translated_offset - center)
+        cv::Point2d fixed_center(standard_center.x + extend_offset.x, standard_center.y + extend_offset.y);
+        cv::Point2d resized_offset(
+            fixed_center.x * (1 - length_ratio) + translated_offset.x * length_ratio,
+            fixed_center.y * (1 - length_ratio) + translated_offset.y * length_ratio);
+        cv::Mat evaluate_convexhull_resized = cv::Mat::zeros(size.extend_width(), size.extend_height(), extend_type);
+        record_draw(DrawLevel::convexhull);
+        fill_hull(evaluate_convexhull_resized, evaluate_hull, length_ratio, resized_offset);
+
+        auto [intersection_sum_resized, union_sum_resized] = get_overlap_sum(standard_extend_mat, evaluate_convexhull_resized, size);
+        if (union_sum_resized == 0)
+        {
+            throw ZeroException();
+        }
+        convexhull_score_resized = intersection_sum_resized / union_sum_resized;
+        if (m_is_alignment_search)
+        {
+            //在原方案附近由粗到细搜索缩放与平移,取重叠得分最高者
+            AlignmentSearcher searcher(
+                standard_hull, evaluate_hull, cv::Size(size.extend_width(), size.extend_height()),
+                extend_offset, fixed_center, length_ratio, translated_offset, m_alignment_search_options);
+            m_alignment_result = searcher.search();
+            convexhull_score_resized = std::max(convexhull_score_resized, m_alignment_result.iou);
+        }
+        return std::make_tuple(convexhull_score, convexhull_score_resized, diff_center);
+    }
     double score(
         std::vector<std::string> standard_lines,
         std::vector<std::string> evaluate_lines,
@@ -2508,110 +3529,36 @@ public:
         //一.求凸包得分
         //位移最大扣20分
         //凸包重叠面积/凸包最大面积
-        m_config.parse_data_1_0(config_line);
-        m_standard_segments = load_from_content(standard_lines, m_config);
-        m_evaluate_segments = load_from_content(evaluate_lines, m_config);
-        m_standard_character.m_segments = m_standard_segments;
-        m_evaluate_character.m_segments = m_evaluate_segments;
+        auto make_request = [&]()
+        {
+            return ScoreRequest{standard_lines, evaluate_lines, char_info, struction_info_array, stroke_info_array, config_line};
+        };
+        return run_request("score_holistic", make_request, [&]()
+                               {
+                                   auto is_character_right = true;
+                                   resolve_local_inputs(standard_lines, evaluate_lines, char_info, struction_info_array, stroke_info_array, is_character_right, false);
+                                   parse_config(config_line);
+                                   prepare(standard_lines, evaluate_lines, char_info, struction_info_array, stroke_info_array);
+                                   return score_holistic(char_info); });
+    }
+    /**
+     * @brief 在prepare之后计算整体评分
+     *
+     */
+    double score_holistic(CharacterInfo char_info)
+    {
         auto character_width = m_config.m_data["character"]["width"].as_integer();
         auto character_height = m_config.m_data["character"]["height"].as_integer();
-        auto standard_mat = m_standard_character.draw(character_width, character_height);
-        auto evaluate_mat = m_evaluate_character.draw(character_width, character_height);
-        ConvexHull standard_convexhull = ConvexHull(standard_mat);
-        ConvexHull evaluate_convexhull = ConvexHull(evaluate_mat);
-        auto standard_center = standard_convexhull.get_center();
-        auto evaluate_center = evaluate_convexhull.get_center();
-        //凸包中心对齐
-        // 1.图片放大2倍
-        cv::Mat standard_extend_mat = cv::Mat::zeros(2 * character_width, 2 * character_height, 2 * m_standard_character.draw(character_width, character_height).type());
-        cv::Mat evaluate_extend_mat = cv::Mat::zeros(2 * character_width, 2 * character_height, 2 * m_standard_character.draw(character_width, character_height).type());
-        cv::Rect roi(character_width / 2, character_height / 2, character_width, character_height);
-        auto standard_convexhull_mat = standard_convexhull.draw();
-        auto evaluate_convexhull_mat = evaluate_convexhull.draw();
-        standard_convexhull_mat.copyTo(standard_extend_mat(roi));
-        evaluate_convexhull_mat.copyTo(evaluate_extend_mat(roi));
-        // 2.中心对齐
-        auto diff_center = standard_center - evaluate_center;
-        cv::Mat evaluate_convexhull_mat_translated(2 * character_width, 2 * character_height, 2 * m_standard_character.draw(character_width, character_height).type());
-        cv::Mat M = cv::Mat::zeros(2, 3, CV_32FC1);
-        M.at<float>(0, 0) = 1;
-        M.at<float>(0, 2) = diff_center.x;
-        M.at<float>(1, 1) = 1;
-        M.at<float>(1, 2) = diff_center.y;
-
-        // cv::imshow("dd1", evaluate_extend_mat);
-        // cv::waitKey(3000);
-        cv::warpAffine(
-            evaluate_extend_mat,
-            evaluate_convexhull_mat_translated,
-            M,
-            cv::Size(2 * character_width, 2 * character_height));
-
-        cv::Mat convexhull_intersection = standard_extend_mat & evaluate_convexhull_mat_translated;
-        cv::Mat convexhull_union = standard_extend_mat | evaluate_convexhull_mat_translated;
-        auto convexhull_score = cv::sum(convexhull_intersection)[0] / cv::sum(convexhull_union)[0];
-
-        // 3.求evaluate_extend_mat的面积,并放大到与standard_extend_mat一致
-        auto area_standard_convexhull = cv::sum(standard_extend_mat);
-        auto area_evaluate_convexhull = cv::sum(evaluate_convexhull_mat_translated);
-        auto area_ratio = area_standard_convexhull[0] / area_evaluate_convexhull[0];
-        auto length_ratio = sqrt(area_ratio);
-        // cv::Mat M_translate = cv::Mat::zeros(3, 3, CV_32FC1);
-        // M_translate.at<float>(0,0) = 1;
-        // M_translate.at<float>(0,2) = -(standard_center.x+character_width/2);
-        // M_translate.at<float>(1,1) = 1;
-        // M_translate.at<float>(1,2) = -(standard_center.y+character_height/2);
-        // M_translate.at<float>(2,2) = 1;
-        cv::Mat M_resize = cv::Mat::zeros(3, 3, CV_32FC1);
-        M_resize.at<float>(0, 0) = length_ratio;
-        M_resize.at<float>(0, 2) = 0;
-        M_resize.at<float>(1, 1) = length_ratio;
-        M_resize.at<float>(1, 2) = 0;
-        M_resize.at<float>(2, 2) = 1;
-        cv::Mat M_translate_inv = cv::Mat::zeros(3, 3, CV_32FC1);
-        M_translate_inv.at<float>(0, 0) = 1;
-        M_translate_inv.at<float>(0, 2) = -(standard_center.x + character_width / 2) * (length_ratio - 1);
-        M_translate_inv.at<float>(1, 1) = 1;
-        M_translate_inv.at<float>(1, 2) = -(standard_center.y + character_height / 2) * (length_ratio - 1);
-        M_translate_inv.at<float>(2, 2) = 1;
-        cv::Mat M_union = M_translate_inv * M_resize;
-        cv::Mat M_union_sub = M_union(cv::Rect(0, 0, 3, 2));
-        // M_resize.at<float>(0,0) = length_ratio;
-        // M_resize.at<float>(0,2) = (standard_center.x+character_width/2)*(length_ratio-1);
-        // M_resize.at<float>(1,1) = length_ratio;
-        // M_resize.at<float>(1,2) = (standard_center.y+character_height/2)*(length_ratio-1);
-        cv::Mat evaluate_convexhull_resized(standard_extend_mat.size().width, standard_extend_mat.size().height, standard_extend_mat.type());
-
-        // cv::imshow("dd1", evaluate_convexhull_mat_translated);
-        // cv::waitKey(3000);
-
-        cv::warpAffine(
-            evaluate_convexhull_mat_translated,
-            evaluate_convexhull_resized,
-            M_union_sub,
-            cv::Size(2 * character_width, 2 * character_height));
-
-        // cv::imshow("dd2", evaluate_convexhull_resized);
-        // cv::waitKey(3000);
-
-        cv::Mat convexhull_intersection_resized = standard_extend_mat & evaluate_convexhull_resized;
-        cv::Mat convexhull_union_resized = standard_extend_mat | evaluate_convexhull_resized;
-        if (cv::sum(convexhull_union_resized)[0] == 0)
-        {
-            throw ZeroException();
-        }
-        auto convexhull_score_resized = cv::sum(convexhull_intersection_resized)[0] / cv::sum(convexhull_union_resized)[0];
-        //把evaluate_convexhull_mat_translated放大
-        // cv::imshow("dd",evaluate_convexhull_mat_translated);
-        // cv::waitKey(3000);
-        // cv::imshow("standard", m_standard_character.draw(character_width, character_height));
-        // cv::waitKey(10000);
-        // cv::imshow("evaluate", m_evaluate_character.draw(character_width, character_height));
-        // cv::waitKey(10000);
-        auto scale_score = get_real_deduction(diff_center.x, character_width / 2, diff_center.y, character_height / 2);
+        auto standard_mat = m_standard_mat;
+        auto evaluate_mat = m_evaluate_mat;
+        //画布尺寸在特化列表中时,2倍画布与位移扣分的除数均为编译期常量
+        auto [convexhull_score, convexhull_score_resized, scale_score] = dispatch_canvas_size(
+            CanvasSizeSpecializations(), character_width, character_height, [&](auto size)
+            {
+                auto [score, score_resized, diff_center] = get_convexhull_score(standard_mat, evaluate_mat, size, true);
+                return std::make_tuple(score, score_resized, get_real_deduction(diff_center.x, diff_center.y, size));
+            });
         //扣结构分:根据配置文件
-        get_stroke_map(m_standard_character, m_standard_segments, char_info, struction_info_array, stroke_info_array, true);
-        get_stroke_map(m_evaluate_character, m_evaluate_segments, char_info, struction_info_array, stroke_info_array, false);
         auto is_struction = m_config.m_data["is_struction"].as_bool();
         auto is_stroke_reliable = m_config.m_data["is_stroke_reliable"].as_bool();
         auto stroke_score = 0.0;
@@ -2637,9 +3584,9 @@ public:
 
                     if (evaluate_stroke_iter->is_reliable)
                     {
-                        auto standard_mat = standard_stroke_iter->draw(character_width, character_height);
-                        auto evaluate_mat = evaluate_stroke_iter->draw(character_width, character_height);
-                        auto angle_info = get_angle_info_half(standard_mat, evaluate_mat);
+                        auto standard_mat = draw(*standard_stroke_iter, DrawLevel::stroke, character_width, character_height);
+                        auto evaluate_mat = draw(*evaluate_stroke_iter, DrawLevel::stroke, character_width, character_height);
+                        auto angle_info = time_stage(Stage::geometry, [&]() { return get_angle_info_half(standard_mat, evaluate_mat); });
                         auto angle = angle_info.diff_half_angle;
                         if (angle_info.diff_half_angle > M_PI)
                         {
@@ -2701,39 +3648,13 @@ public:
                          evaluate_struction_iter != evaluate_structions.end();
                     ++standard_struction_iter, ++evaluate_struction_iter)
                 {
-                    auto standard_struction_mat = standard_struction_iter->draw(character_width, character_height);
-                    auto evaluate_struction_mat = evaluate_struction_iter->draw(character_width, character_height);
-
-                    ConvexHull standard_convexhull = ConvexHull(standard_struction_mat);
-                    ConvexHull evaluate_convexhull = ConvexHull(evaluate_struction_mat);
-                    auto standard_center = standard_convexhull.get_center();
-                    auto evaluate_center = evaluate_convexhull.get_center();
-
-                    cv::Mat standard_extend_mat = cv::Mat::zeros(2 * character_width, 2 * character_height, 2 * m_standard_character.draw(character_width, character_height).type());
-                    cv::Mat evaluate_extend_mat = cv::Mat::zeros(2 * character_width, 2 * character_height, 2 * m_standard_character.draw(character_width, character_height).type());
-                    cv::Rect roi(character_width / 2, character_height / 2, character_width, character_height);
-                    auto standard_convexhull_mat = standard_convexhull.draw();
-                    auto evaluate_convexhull_mat = evaluate_convexhull.draw();
-                    standard_convexhull_mat.copyTo(standard_extend_mat(roi));
-                    evaluate_convexhull_mat.copyTo(evaluate_extend_mat(roi));
-
-                    auto diff_center = standard_center - evaluate_center;
-                    cv::Mat evaluate_convexhull_mat_translated(2 * character_width, 2 * character_height, 2 * m_standard_character.draw(character_width, character_height).type());
-                    cv::Mat M = cv::Mat::zeros(2, 3, CV_32FC1);
-                    M.at<float>(0, 0) = 1;
-                    M.at<float>(0, 2) = diff_center.x;
-                    M.at<float>(1, 1) = 1;
-                    M.at<float>(1, 2) = diff_center.y;
-
-                    cv::warpAffine(
-                        evaluate_extend_mat,
-                        evaluate_convexhull_mat_translated,
-                        M,
-                        cv::Size(2 * character_width, 2 * character_height));
-
-                    cv::Mat convexhull_intersection = standard_extend_mat & evaluate_convexhull_mat_translated;
-                    cv::Mat convexhull_union = standard_extend_mat | evaluate_convexhull_mat_translated;
-                    auto struction_score = cv::sum(convexhull_intersection)[0] / cv::sum(convexhull_union)[0];
+                    TraceScope trace("struction", [&]()
+                                     { return "holistic struction " + std::to_string(standard_struction_iter - standard_structions.begin()) + " " + m_standard_character.type; });
+                    auto standard_struction_mat = draw(*standard_struction_iter, DrawLevel::struction, character_width, character_height);
+                    auto evaluate_struction_mat = draw(*evaluate_struction_iter, DrawLevel::struction, character_width, character_height);
+                    auto struction_score = dispatch_canvas_size(
+                        CanvasSizeSpecializations(), character_width, character_height, [&](auto size)
+                        { return std::get<0>(get_convexhull_score(standard_struction_mat, evaluate_struction_mat, size, false)); });
                     all_struction_score += struction_score;
                 }
                 all_struction_score /= standard_structions.size();
@@ -2753,6 +3674,63 @@ public:
         // auto scale_score = (1-std::max({abs((double)diff_center.x/character_width/2), abs((double)diff_center.y/character_height/2)}));
     }
 
+    /**
+     * @brief 在语料上比较开启重采样前后的得分,确认重采样不改变评测结果
+     *
+     * @param requests 评测语料
+     * @param options 待验证的重采样参数
+     * @param epsilon 允许的最大得分差,score为0-100的整数分,holistic为0-1的整体分
+     */
+    ResampleValidationReport validate_resample_options(std::vector<ScoreRequest> requests, ResampleOptions options, double epsilon)
+    {
+        ResampleValidationReport report;
+        auto old_options = m_resample_options;
+        for (auto i = 0; i < requests.size(); ++i)
+        {
+            auto request = requests[i];
+            double scores[2];
+            double holistic_scores[2];
+            for (auto j = 0; j < 2; ++j)
+            {
+                set_resample_options(j == 0 ? ResampleOptions() : options);
+                try
+                {
+                    auto [result, red_index_array] = score(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.config_line, request.is_character_right);
+                    scores[j] = result["score"].as_float();
+                    holistic_scores[j] = score(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.config_line);
+                }
+                catch (const std::exception &e)
+                {
+                    scores[j] = NAN;
+                    holistic_scores[j] = NAN;
+                }
+            }
+            for (auto point_count : m_standard_point_counts)
+            {
+                report.raw_point_count += point_count.raw_count;
+                report.resampled_point_count += point_count.resampled_count;
+            }
+            for (auto point_count : m_evaluate_point_counts)
+            {
+                report.raw_point_count += point_count.raw_count;
+                report.resampled_point_count += point_count.resampled_count;
+            }
+            //两次都抛异常视为一致
+            auto score_diff = (std::isnan(scores[0]) && std::isnan(scores[1])) ? 0.0 : std::abs(scores[0] - scores[1]);
+            auto holistic_diff = (std::isnan(holistic_scores[0]) && std::isnan(holistic_scores[1])) ? 0.0 : std::abs(holistic_scores[0] - holistic_scores[1]);
+            if (std::isnan(score_diff) || std::isnan(holistic_diff) || score_diff > epsilon || holistic_diff > epsilon / 100)
+            {
+                report.failed_index_array.push_back(i);
+            }
+            report.max_score_diff = std::max(report.max_score_diff, std::isnan(score_diff) ? INFINITY : score_diff);
+            report.max_holistic_diff = std::max(report.max_holistic_diff, std::isnan(holistic_diff) ? INFINITY : holistic_diff);
+            ++report.request_count;
+        }
+        set_resample_options(old_options);
+        report.is_passed = report.failed_index_array.empty();
+        return report;
+    }
+
 protected:
     std::vector<Segment> m_standard_segments; //从dot里读取到的原始segment
     std::vector<Segment> m_evaluate_segments; //从dot里读取到的原始segment
@@ -2760,5 +3738,41 @@ protected:
     Character m_standard_character;
     Dot dot;
     Config m_config; //扣分的配置
+    ResampleOptions m_resample_options;
+    bool m_is_wrong_character_fast_path = false;
+    cv::Mat m_standard_mat; //prepare画出的标准字整字图
+    cv::Mat m_evaluate_mat; //prepare画出的测试字整字图
+    std::vector<SegmentPointCount> m_standard_point_counts; //最近一次读取的标准字点数
+    std::vector<SegmentPointCount> m_evaluate_point_counts; //最近一次读取的测试字点数
+    std::shared_ptr<SlowRequestLog> m_slow_request_log; //慢请求记录,为空时不监测
+    bool m_is_memory_accounting = false;
+    RequestMemoryStats m_memory_stats; //最近一次请求的内存统计
+    bool m_is_alignment_search = false;
+    AlignmentSearchOptions m_alignment_search_options;
+    AlignmentResult m_alignment_result; //最近一次整体评分的对齐搜索结果
+    bool m_is_local_stroke_map = false;
+    StrokeMapperOptions m_stroke_mapper_options;
+    bool m_is_local_character_check = false;
+    CharacterVerifierOptions m_character_verifier_options;
+    CharacterCheckResult m_character_check_result; //最近一次请求的本地错字预判
+    bool m_is_standard_dots_cached = false;
+    std::vector<std::string> m_dots_standard_lines; //m_standard_dots对应的标准字
+    std::vector<DotLine> m_standard_dots;
+    bool m_is_standard_shape_cached = false; //m_standard_shape由m_standard_dots求得
+    CharacterShape m_standard_shape;
+    WritingSpeedOptions m_writing_speed_options;
+    WritingSpeedStats m_writing_speed_stats; //最近一次读取的测试字的书写速度统计
+    bool m_is_local_struction = false;
+    StructionGrouperOptions m_struction_grouper_options;
+    bool m_is_reference_cache = false;
+    bool m_is_config_cached = false;
+    std::string m_cached_config_line;
+    bool m_is_standard_cached = false;
+    std::vector<std::string> m_cached_standard_lines;
+    std::vector<Segment> m_cached_standard_segments;
+    std::vector<SegmentPointCount> m_cached_standard_point_counts;
+    std::shared_ptr<const ReferenceStore> m_reference_store;
+    int m_store_config_index = -1; //m_config来自字库时为其序号
+    std::shared_ptr<CancellationToken> m_cancellation_token;
 };
 #endif
\ No newline at end of file
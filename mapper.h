@@ -0,0 +1,488 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "configor/json.hpp"
+#include "deadline.h"
+#include "info.h"
+
+//一行dot中的点,坐标归一化到书写区域
+class DotLine
+{
+public:
+    std::vector<cv::Point2d> points;
+    std::vector<double> times; //各点的时间戳t,没有t的点为NaN
+    bool has_area = false;     //书写区域宽高都不为0,为false时points为空
+};
+
+//读取一行dot,坐标归一化到书写区域
+inline DotLine parse_dot_line(const std::string &line)
+{
+    DotLine dot_line;
+    auto line_obj = configor::json::parse(line);
+    auto start_x = line_obj["startX"].as_float();
+    auto start_y = line_obj["startY"].as_float();
+    auto width = line_obj["endX"].as_float() - start_x;
+    auto height = line_obj["endY"].as_float() - start_y;
+    if (width == 0 || height == 0)
+    {
+        return dot_line;
+    }
+    dot_line.has_area = true;
+    for (auto item : line_obj["list"])
+    {
+        dot_line.points.push_back(cv::Point2d((item["x"].as_float() - start_x) / width, (item["y"].as_float() - start_y) / height));
+        auto time = item["t"];
+        dot_line.times.push_back(time.is_number() ? time.as_float() : std::numeric_limits<double>::quiet_NaN());
+    }
+    return dot_line;
+}
+
+//一次读取全部行,本地映射、部件划分与错字预判共用,每行只解析一次
+inline std::vector<DotLine> parse_dot_lines(const std::vector<std::string> &lines)
+{
+    std::vector<DotLine> dot_lines;
+    dot_lines.reserve(lines.size());
+    for (auto &line : lines)
+    {
+        dot_lines.push_back(parse_dot_line(line));
+    }
+    return dot_lines;
+}
+
+inline std::vector<cv::Point2d> parse_dot_points(const std::string &line)
+{
+    return parse_dot_line(line).points;
+}
+
+class StrokeMapperOptions
+{
+public:
+    int sample_count = 8;              //描述子沿弧长重采样的点数
+    int grid_size = 4;                 //参考笔画空间网格的边长格数
+    double grid_margin = 0.15;         //外接矩形向外扩展的距离,书写区域边长的比例
+    double position_weight = 1.0;      //重采样点平均距离
+    double direction_weight = 0.5;     //起止方向夹角
+    double length_weight = 0.2;        //长度比的对数
+    double curvature_weight = 0.1;     //弯曲度之差
+    double skip_cost = 0.35;           //漏写一笔或多写一段的代价,配对代价超过其2倍时不成立
+    double reliable_cost = 0.15;       //代价低于该值的配对is_reliable为true
+    double join_distance = 0.08;       //断笔拼接时前一段终点与后一段起点的最大距离
+};
+
+//笔画或笔画段的描述子,坐标已归一化到书写区域的0-1
+class StrokeDescriptor
+{
+public:
+    std::vector<cv::Point2d> points;  //原始点
+    std::vector<cv::Point2d> samples; //沿弧长等距重采样
+    cv::Point2d direction;            //起点指向终点的单位向量
+    double length = 0.0;              //折线长度
+    double curvature = 0.0;           //偏离弦的最大距离与弦长之比
+    cv::Rect2d rect;                  //外接矩形
+};
+
+/**
+ * @brief 在本地把测试字的笔画段对应到标准字笔画,输出与网络端相同格式的StrokeInfo
+ *
+ * 1. 每个笔画与笔画段计算描述子:位置(重采样点)、方向、长度、弯曲度
+ * 2. 参考笔画按外接矩形登记到空间网格,笔画段只与相邻网格中的参考笔画计算代价
+ * 3. 以漏写/多写的代价补成方阵,用匈牙利算法求总代价最小的一一对应
+ * 4. 未配对的笔画段若与某笔已配对段首尾相接且拼接后代价更低,视为断笔并入该笔
+ */
+class StrokeMapper
+{
+public:
+    StrokeMapper(StrokeMapperOptions options = StrokeMapperOptions()) : m_options(options)
+    {
+    }
+    /**
+     * @brief 求测试字每个笔画段对应的标准字笔画
+     *
+     * @param standard_lines 标准字,每行一笔,顺序即标准笔顺
+     * @param evaluate_lines 测试字,每行一个笔画段,顺序即书写顺序
+     * @param stroke_names 标准字各笔的笔画名
+     * @return 按标准笔顺排列,order为标准字笔画序号,未写的笔画is_skip为true
+     */
+    std::vector<StrokeInfo> map(
+        const std::vector<std::string> &standard_lines,
+        const std::vector<std::string> &evaluate_lines,
+        const std::vector<std::string> &stroke_names)
+    {
+        return map(parse_dot_lines(standard_lines), parse_dot_lines(evaluate_lines), stroke_names);
+    }
+    //使用已解析的dot
+    std::vector<StrokeInfo> map(
+        const std::vector<DotLine> &standard_dots,
+        const std::vector<DotLine> &evaluate_dots,
+        const std::vector<std::string> &stroke_names)
+    {
+        std::vector<StrokeDescriptor> standard_descriptors;
+        std::vector<StrokeDescriptor> evaluate_descriptors;
+        for (auto &dot_line : standard_dots)
+        {
+            standard_descriptors.push_back(get_descriptor(dot_line.points));
+        }
+        for (auto &dot_line : evaluate_dots)
+        {
+            evaluate_descriptors.push_back(get_descriptor(dot_line.points));
+        }
+        auto [assignment, costs] = assign(standard_descriptors, evaluate_descriptors);
+        join_broken_segments(standard_descriptors, evaluate_descriptors, assignment, costs);
+
+        std::vector<StrokeInfo> stroke_info_array;
+        for (auto i = 0; i < standard_descriptors.size(); ++i)
+        {
+            StrokeInfo stroke_info;
+            stroke_info.name = i < stroke_names.size() ? stroke_names[i] : "";
+            stroke_info.order = i;
+            stroke_info.is_valid = true;
+            stroke_info.segment_index_array = assignment[i];
+            stroke_info.is_skip = assignment[i].empty();
+            stroke_info.is_reliable = !stroke_info.is_skip && costs[i] <= m_options.reliable_cost;
+            stroke_info_array.push_back(stroke_info);
+        }
+        return stroke_info_array;
+    }
+    //两个描述子之间的代价
+    double get_cost(const StrokeDescriptor &standard, const StrokeDescriptor &evaluate) const
+    {
+        if (standard.samples.empty() || evaluate.samples.empty())
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        //反向书写的笔画仍按位置配对,方向差另计代价
+        auto position = 0.0;
+        auto reversed_position = 0.0;
+        auto sample_count = standard.samples.size();
+        for (auto i = 0; i < sample_count; ++i)
+        {
+            position += cv::norm(standard.samples[i] - evaluate.samples[i]);
+            reversed_position += cv::norm(standard.samples[i] - evaluate.samples[sample_count - 1 - i]);
+        }
+        position = std::min(position, reversed_position) / sample_count;
+        auto direction = 0.5 * (1 - standard.direction.dot(evaluate.direction));
+        auto length = std::abs(std::log((standard.length + 1e-3) / (evaluate.length + 1e-3)));
+        auto curvature = std::abs(standard.curvature - evaluate.curvature);
+        return m_options.position_weight * position +
+               m_options.direction_weight * direction +
+               m_options.length_weight * length +
+               m_options.curvature_weight * curvature;
+    }
+    StrokeDescriptor get_descriptor(const std::vector<cv::Point2d> &points) const
+    {
+        StrokeDescriptor descriptor;
+        descriptor.points = points;
+        if (points.empty())
+        {
+            return descriptor;
+        }
+        std::vector<double> arc_lengths{0.0};
+        for (auto i = 1; i < points.size(); ++i)
+        {
+            arc_lengths.push_back(arc_lengths.back() + cv::norm(points[i] - points[i - 1]));
+        }
+        descriptor.length = arc_lengths.back();
+        auto sample_count = std::max(2, m_options.sample_count);
+        for (auto k = 0, j = 0; k < sample_count; ++k)
+        {
+            auto target = descriptor.length * k / (sample_count - 1);
+            while (j + 1 < points.size() && arc_lengths[j + 1] < target)
+            {
+                ++j;
+            }
+            if (j + 1 >= points.size() || arc_lengths[j + 1] == arc_lengths[j])
+            {
+                descriptor.samples.push_back(points[j]);
+                continue;
+            }
+            auto t = (target - arc_lengths[j]) / (arc_lengths[j + 1] - arc_lengths[j]);
+            descriptor.samples.push_back(points[j] + (points[j + 1] - points[j]) * t);
+        }
+        auto chord = points.back() - points.front();
+        auto chord_length = cv::norm(chord);
+        if (chord_length > 0)
+        {
+            descriptor.direction = chord / chord_length;
+            auto max_distance = 0.0;
+            for (auto &point : points)
+            {
+                auto offset = point - points.front();
+                max_distance = std::max(max_distance, std::abs(offset.x * chord.y - offset.y * chord.x) / chord_length);
+            }
+            descriptor.curvature = max_distance / chord_length;
+        }
+        auto min_x = points[0].x, max_x = points[0].x, min_y = points[0].y, max_y = points[0].y;
+        for (auto &point : points)
+        {
+            min_x = std::min(min_x, point.x);
+            max_x = std::max(max_x, point.x);
+            min_y = std::min(min_y, point.y);
+            max_y = std::max(max_y, point.y);
+        }
+        descriptor.rect = cv::Rect2d(min_x, min_y, max_x - min_x, max_y - min_y);
+        return descriptor;
+    }
+
+protected:
+    //参考笔画登记到网格,返回每个笔画段可能对应的参考笔画
+    std::vector<std::vector<int>> get_candidates(const std::vector<StrokeDescriptor> &standard_descriptors, const std::vector<StrokeDescriptor> &evaluate_descriptors) const
+    {
+        auto grid_size = std::max(1, m_options.grid_size);
+        auto get_cell_range = [&](const cv::Rect2d &rect)
+        {
+            auto to_cell = [&](double value)
+            {
+                return std::clamp((int)std::floor(value * grid_size), 0, grid_size - 1);
+            };
+            return cv::Rect(
+                cv::Point(to_cell(rect.x - m_options.grid_margin), to_cell(rect.y - m_options.grid_margin)),
+                cv::Point(to_cell(rect.x + rect.width + m_options.grid_margin) + 1, to_cell(rect.y + rect.height + m_options.grid_margin) + 1));
+        };
+        std::vector<std::vector<int>> grid(grid_size * grid_size);
+        for (auto i = 0; i < standard_descriptors.size(); ++i)
+        {
+            auto range = get_cell_range(standard_descriptors[i].rect);
+            for (auto y = range.y; y < range.y + range.height; ++y)
+            {
+                for (auto x = range.x; x < range.x + range.width; ++x)
+                {
+                    grid[y * grid_size + x].push_back(i);
+                }
+            }
+        }
+        std::vector<std::vector<int>> candidates;
+        for (auto &descriptor : evaluate_descriptors)
+        {
+            std::vector<bool> is_candidate(standard_descriptors.size(), false);
+            auto range = get_cell_range(descriptor.rect);
+            for (auto y = range.y; y < range.y + range.height; ++y)
+            {
+                for (auto x = range.x; x < range.x + range.width; ++x)
+                {
+                    for (auto i : grid[y * grid_size + x])
+                    {
+                        is_candidate[i] = true;
+                    }
+                }
+            }
+            std::vector<int> indexes;
+            for (auto i = 0; i < is_candidate.size(); ++i)
+            {
+                if (is_candidate[i])
+                {
+                    indexes.push_back(i);
+                }
+            }
+            candidates.push_back(indexes);
+        }
+        return candidates;
+    }
+    /**
+     * @brief 一一对应
+     *
+     * @return 每个参考笔画对应的笔画段下标, 每个参考笔画的配对代价
+     */
+    std::tuple<std::vector<std::vector<int>>, std::vector<double>> assign(
+        const std::vector<StrokeDescriptor> &standard_descriptors,
+        const std::vector<StrokeDescriptor> &evaluate_descriptors) const
+    {
+        auto standard_count = (int)standard_descriptors.size();
+        auto evaluate_count = (int)evaluate_descriptors.size();
+        auto size = standard_count + evaluate_count;
+        //左上为配对代价,右上与左下为漏写/多写,右下为0
+        std::vector<std::vector<double>> cost_matrix(size, std::vector<double>(size, 0.0));
+        auto forbidden_cost = 1e6;
+        for (auto i = 0; i < standard_count; ++i)
+        {
+            for (auto j = 0; j < evaluate_count; ++j)
+            {
+                cost_matrix[i][j] = forbidden_cost;
+            }
+            for (auto j = evaluate_count; j < size; ++j)
+            {
+                cost_matrix[i][j] = j - evaluate_count == i ? m_options.skip_cost : forbidden_cost;
+            }
+        }
+        for (auto i = standard_count; i < size; ++i)
+        {
+            for (auto j = 0; j < evaluate_count; ++j)
+            {
+                cost_matrix[i][j] = i - standard_count == j ? m_options.skip_cost : forbidden_cost;
+            }
+        }
+        auto candidates = get_candidates(standard_descriptors, evaluate_descriptors);
+        for (auto j = 0; j < evaluate_count; ++j)
+        {
+            for (auto i : candidates[j])
+            {
+                auto cost = get_cost(standard_descriptors[i], evaluate_descriptors[j]);
+                if (cost < 2 * m_options.skip_cost)
+                {
+                    cost_matrix[i][j] = cost;
+                }
+            }
+        }
+        auto match = solve_assignment(cost_matrix);
+        std::vector<std::vector<int>> assignment(standard_count);
+        std::vector<double> costs(standard_count, 0.0);
+        for (auto i = 0; i < standard_count; ++i)
+        {
+            auto j = match[i];
+            if (j < evaluate_count && cost_matrix[i][j] < forbidden_cost)
+            {
+                assignment[i].push_back(j);
+                costs[i] = cost_matrix[i][j];
+            }
+        }
+        return {assignment, costs};
+    }
+    //断笔:未配对的段接在已配对段的首或尾,拼接后代价更低时并入
+    void join_broken_segments(
+        const std::vector<StrokeDescriptor> &standard_descriptors,
+        const std::vector<StrokeDescriptor> &evaluate_descriptors,
+        std::vector<std::vector<int>> &assignment,
+        std::vector<double> &costs) const
+    {
+        std::vector<bool> is_assigned(evaluate_descriptors.size(), false);
+        for (auto &segment_index_array : assignment)
+        {
+            for (auto j : segment_index_array)
+            {
+                is_assigned[j] = true;
+            }
+        }
+        for (auto j = 0; j < evaluate_descriptors.size(); ++j)
+        {
+            if (is_assigned[j] || evaluate_descriptors[j].points.empty())
+            {
+                continue;
+            }
+            auto best_index = -1;
+            auto best_cost = 0.0;
+            std::vector<int> best_segment_index_array;
+            for (auto i = 0; i < assignment.size(); ++i)
+            {
+                if (assignment[i].empty())
+                {
+                    continue;
+                }
+                auto segment_index_array = assignment[i];
+                segment_index_array.push_back(j);
+                std::sort(segment_index_array.begin(), segment_index_array.end());
+                //按书写顺序拼接,相邻两段首尾需足够接近
+                std::vector<cv::Point2d> points;
+                auto is_connected = true;
+                for (auto k : segment_index_array)
+                {
+                    auto &segment_points = evaluate_descriptors[k].points;
+                    if (!points.empty() && cv::norm(points.back() - segment_points.front()) > m_options.join_distance)
+                    {
+                        is_connected = false;
+                        break;
+                    }
+                    points.insert(points.end(), segment_points.begin(), segment_points.end());
+                }
+                if (!is_connected)
+                {
+                    continue;
+                }
+                auto cost = get_cost(standard_descriptors[i], get_descriptor(points));
+                if (cost < costs[i] && (best_index == -1 || cost < best_cost))
+                {
+                    best_index = i;
+                    best_cost = cost;
+                    best_segment_index_array = segment_index_array;
+                }
+            }
+            if (best_index != -1)
+            {
+                assignment[best_index] = best_segment_index_array;
+                costs[best_index] = best_cost;
+                is_assigned[j] = true;
+            }
+        }
+    }
+    /**
+     * @brief 匈牙利算法,方阵上总代价最小的完美匹配
+     *
+     * @return 第i行匹配的列
+     */
+    static std::vector<int> solve_assignment(const std::vector<std::vector<double>> &cost_matrix)
+    {
+        auto n = (int)cost_matrix.size();
+        auto infinity = std::numeric_limits<double>::infinity();
+        // 1-based,第0列为哨兵
+        std::vector<double> u(n + 1, 0.0), v(n + 1, 0.0), min_values(n + 1);
+        std::vector<int> row_of_column(n + 1, 0), way(n + 1, 0);
+        std::vector<bool> is_used(n + 1);
+        for (auto i = 1; i <= n; ++i)
+        {
+            //笔画段很多时耗时为n^3,每行检查一次是否超时
+            check_cancellation();
+            row_of_column[0] = i;
+            auto column = 0;
+            std::fill(min_values.begin(), min_values.end(), infinity);
+            std::fill(is_used.begin(), is_used.end(), false);
+            do
+            {
+                is_used[column] = true;
+                auto row = row_of_column[column];
+                auto delta = infinity;
+                auto next_column = 0;
+                for (auto j = 1; j <= n; ++j)
+                {
+                    if (is_used[j])
+                    {
+                        continue;
+                    }
+                    auto value = cost_matrix[row - 1][j - 1] - u[row] - v[j];
+                    if (value < min_values[j])
+                    {
+                        min_values[j] = value;
+                        way[j] = column;
+                    }
+                    if (min_values[j] < delta)
+                    {
+                        delta = min_values[j];
+                        next_column = j;
+                    }
+                }
+                for (auto j = 0; j <= n; ++j)
+                {
+                    if (is_used[j])
+                    {
+                        u[row_of_column[j]] += delta;
+                        v[j] -= delta;
+                    }
+                    else
+                    {
+                        min_values[j] -= delta;
+                    }
+                }
+                column = next_column;
+            } while (row_of_column[column] != 0);
+            do
+            {
+                auto previous_column = way[column];
+                row_of_column[column] = row_of_column[previous_column];
+                column = previous_column;
+            } while (column != 0);
+        }
+        std::vector<int> match(n, -1);
+        for (auto j = 1; j <= n; ++j)
+        {
+            if (row_of_column[j] != 0)
+            {
+                match[row_of_column[j] - 1] = j - 1;
+            }
+        }
+        return match;
+    }
+    StrokeMapperOptions m_options;
+};
+#endif
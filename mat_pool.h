@@ -0,0 +1,222 @@
+#ifndef MAT_POOL_H
+#define MAT_POOL_H
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "memory.h"
+
+//一个线程缓存的空闲画布,按字节数分组
+class MatPoolCache
+{
+public:
+    std::unordered_map<std::size_t, std::vector<void *>> free_blocks;
+    std::size_t cached_bytes = 0;
+    std::uint64_t hit_count = 0;  //由缓存满足的分配次数
+    std::uint64_t miss_count = 0; //新分配内存的次数
+    ~MatPoolCache()
+    {
+        for (auto &[size, blocks] : free_blocks)
+        {
+            for (auto block : blocks)
+            {
+                cv::fastFree(block);
+            }
+        }
+        get_is_destroyed() = true;
+    }
+    //线程退出时缓存析构之后,再析构的thread_local Mat直接归还系统
+    static bool &get_is_destroyed()
+    {
+        thread_local bool is_destroyed = false;
+        return is_destroyed;
+    }
+};
+
+class MatPoolStats
+{
+public:
+    std::uint64_t hit_count = 0;
+    std::uint64_t miss_count = 0;
+    std::size_t cached_bytes = 0;
+};
+
+/**
+ * @brief 复用画布内存的Mat分配器
+ *
+ * 释放的数据按字节数放入当前线程的缓存,之后同样大小的分配直接取用,
+ * 评测中各层级draw()、凸包对齐的放大画布与中间结果都是固定的几种尺寸,稳定后不再向系统申请内存
+ * 引用外部数据的Mat交给安装前的默认分配器处理
+ * install后对整个进程生效;已安装CountingMatAllocator时装在其下,统计照常
+ */
+class MatPoolAllocator : public cv::MatAllocator
+{
+public:
+    constexpr static std::size_t MAX_BLOCK_COUNT = 16;                  //每种字节数最多缓存的块数
+    constexpr static std::size_t MAX_CACHED_BYTES = 64 * 1024 * 1024;   //每个线程最多缓存的字节数
+
+    static void install()
+    {
+        std::lock_guard<std::mutex> lock(get_mat_allocator_mutex());
+        if (get_installed() != nullptr)
+        {
+            return;
+        }
+        auto counting_allocator = CountingMatAllocator::get_installed();
+        if (counting_allocator != nullptr)
+        {
+            static MatPoolAllocator allocator(cv::Mat::getStdAllocator());
+            counting_allocator->set_allocator(&allocator);
+            get_installed() = &allocator;
+        }
+        else
+        {
+            static MatPoolAllocator allocator(cv::Mat::getDefaultAllocator());
+            cv::Mat::setDefaultAllocator(&allocator);
+            get_installed() = &allocator;
+        }
+    }
+    static MatPoolAllocator *&get_installed()
+    {
+        static MatPoolAllocator *allocator = nullptr;
+        return allocator;
+    }
+    //关闭后不再放入缓存,已缓存的块仍可取用
+    static void set_enabled(bool is_enabled)
+    {
+        get_is_enabled().store(is_enabled, std::memory_order_relaxed);
+    }
+    static bool is_enabled()
+    {
+        return get_is_enabled().load(std::memory_order_relaxed);
+    }
+    //当前线程的缓存统计
+    static MatPoolStats get_thread_stats()
+    {
+        MatPoolStats stats;
+        auto cache = get_thread_cache();
+        if (cache != nullptr)
+        {
+            stats.hit_count = cache->hit_count;
+            stats.miss_count = cache->miss_count;
+            stats.cached_bytes = cache->cached_bytes;
+        }
+        return stats;
+    }
+    //释放当前线程缓存的全部空闲块
+    static void clear_thread_cache()
+    {
+        auto cache = get_thread_cache();
+        if (cache == nullptr)
+        {
+            return;
+        }
+        for (auto &[size, blocks] : cache->free_blocks)
+        {
+            for (auto block : blocks)
+            {
+                cv::fastFree(block);
+            }
+        }
+        cache->free_blocks.clear();
+        cache->cached_bytes = 0;
+    }
+
+    MatPoolAllocator(cv::MatAllocator *allocator) : m_allocator(allocator)
+    {
+    }
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        if (data != nullptr)
+        {
+            return m_allocator->allocate(dims, sizes, type, data, step, flags, usage_flags);
+        }
+        //与OpenCV默认分配器相同的连续布局
+        std::size_t total = CV_ELEM_SIZE(type);
+        for (auto i = dims - 1; i >= 0; --i)
+        {
+            if (step != nullptr)
+            {
+                step[i] = total;
+            }
+            total *= sizes[i];
+        }
+        void *block = nullptr;
+        auto cache = get_thread_cache();
+        if (cache != nullptr)
+        {
+            auto iter = cache->free_blocks.find(total);
+            if (iter != cache->free_blocks.end() && !iter->second.empty())
+            {
+                block = iter->second.back();
+                iter->second.pop_back();
+                cache->cached_bytes -= total;
+                ++cache->hit_count;
+            }
+            else
+            {
+                ++cache->miss_count;
+            }
+        }
+        if (block == nullptr)
+        {
+            block = cv::fastMalloc(total);
+        }
+        auto u = new cv::UMatData(this);
+        u->data = u->origdata = (unsigned char *)block;
+        u->size = total;
+        return u;
+    }
+    bool allocate(cv::UMatData *data, cv::AccessFlag access_flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        return m_allocator->allocate(data, access_flags, usage_flags);
+    }
+    void deallocate(cv::UMatData *data) const override
+    {
+        if (data == nullptr)
+        {
+            return;
+        }
+        if ((data->flags & cv::UMatData::USER_ALLOCATED) == 0 && data->origdata != nullptr)
+        {
+            auto cache = get_thread_cache();
+            if (cache != nullptr && is_enabled() && cache->cached_bytes + data->size <= MAX_CACHED_BYTES)
+            {
+                auto &blocks = cache->free_blocks[data->size];
+                if (blocks.size() < MAX_BLOCK_COUNT)
+                {
+                    blocks.push_back(data->origdata);
+                    cache->cached_bytes += data->size;
+                    data->origdata = nullptr;
+                }
+            }
+            if (data->origdata != nullptr)
+            {
+                cv::fastFree(data->origdata);
+                data->origdata = nullptr;
+            }
+        }
+        delete data;
+    }
+
+protected:
+    static std::atomic<bool> &get_is_enabled()
+    {
+        static std::atomic<bool> is_enabled{true};
+        return is_enabled;
+    }
+    //线程退出后返回空
+    static MatPoolCache *get_thread_cache()
+    {
+        if (MatPoolCache::get_is_destroyed())
+        {
+            return nullptr;
+        }
+        thread_local MatPoolCache cache;
+        return &cache;
+    }
+    cv::MatAllocator *m_allocator;
+};
+#endif
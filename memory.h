@@ -0,0 +1,223 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "configor/json.hpp"
+
+//画图的层级
+enum class DrawLevel
+{
+    stroke,
+    struction,
+    character,
+    convexhull,
+    count,
+};
+constexpr int DRAW_LEVEL_COUNT = (int)DrawLevel::count;
+
+inline const char *get_draw_level_name(DrawLevel level)
+{
+    static const char *names[] = {"stroke", "struction", "character", "convexhull"};
+    return names[(int)level];
+}
+
+/**
+ * @brief 一次请求的内存统计
+ *
+ * Mat的分配由CountingMatAllocator统计,只统计OpenCV自己分配的数据,不含引用外部数据的Mat
+ */
+class RequestMemoryStats
+{
+public:
+    std::uint64_t mat_allocation_count = 0;
+    std::uint64_t mat_allocated_bytes = 0; //累计分配字节数
+    std::uint64_t mat_peak_bytes = 0;      //请求内同时存活的Mat数据的最大字节数
+    std::uint64_t mat_max_bytes = 0;       //最大的一次分配
+    std::int64_t mat_live_bytes = 0;       //当前存活字节数,请求前分配、请求内释放的部分会使其偏小
+    int draw_counts[DRAW_LEVEL_COUNT] = {};
+    std::uint64_t json_node_count = 0; //解析笔画段、配置与生成结果时创建的json节点数
+    std::uint64_t comment_bytes = 0;   //各层级评语字符串的字节数
+    std::uint64_t sound_bytes = 0;     //各层级语音字符串的字节数
+
+    configor::json to_json() const
+    {
+        configor::json res;
+        res["mat_allocation_count"] = (long long)mat_allocation_count;
+        res["mat_allocated_bytes"] = (long long)mat_allocated_bytes;
+        res["mat_peak_bytes"] = (long long)mat_peak_bytes;
+        res["mat_max_bytes"] = (long long)mat_max_bytes;
+        configor::json draw;
+        for (auto i = 0; i < DRAW_LEVEL_COUNT; ++i)
+        {
+            draw[get_draw_level_name((DrawLevel)i)] = draw_counts[i];
+        }
+        res["draw_counts"] = draw;
+        res["json_node_count"] = (long long)json_node_count;
+        res["comment_bytes"] = (long long)comment_bytes;
+        res["sound_bytes"] = (long long)sound_bytes;
+        return res;
+    }
+};
+
+//当前线程正在统计的请求,为空时不统计
+inline RequestMemoryStats *&get_thread_request_memory_stats()
+{
+    thread_local RequestMemoryStats *stats = nullptr;
+    return stats;
+}
+
+//作用域内当前线程的分配、画图与json统计到stats,可嵌套
+class RequestMemoryScope
+{
+public:
+    RequestMemoryScope(RequestMemoryStats *stats) : m_previous(get_thread_request_memory_stats())
+    {
+        get_thread_request_memory_stats() = stats;
+    }
+    ~RequestMemoryScope()
+    {
+        get_thread_request_memory_stats() = m_previous;
+    }
+    RequestMemoryScope(const RequestMemoryScope &) = delete;
+    RequestMemoryScope &operator=(const RequestMemoryScope &) = delete;
+
+protected:
+    RequestMemoryStats *m_previous;
+};
+
+//安装或更换cv::Mat默认分配器时加锁
+inline std::mutex &get_mat_allocator_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+/**
+ * @brief 统计Mat分配的分配器,分配与释放转交给安装前的默认分配器
+ *
+ * install后对整个进程生效,没有RequestMemoryScope的线程只多一次thread_local读取
+ */
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+    //安装为cv::Mat的默认分配器,重复调用无效果
+    static void install()
+    {
+        std::lock_guard<std::mutex> lock(get_mat_allocator_mutex());
+        if (get_installed() == nullptr)
+        {
+            static CountingMatAllocator allocator(cv::Mat::getDefaultAllocator());
+            cv::Mat::setDefaultAllocator(&allocator);
+            get_installed() = &allocator;
+        }
+    }
+    //已安装的实例,未安装时为空
+    static CountingMatAllocator *&get_installed()
+    {
+        static CountingMatAllocator *allocator = nullptr;
+        return allocator;
+    }
+    CountingMatAllocator(cv::MatAllocator *allocator) : m_allocator(allocator)
+    {
+    }
+    //更换实际分配内存的分配器,用于在统计之下再装入其他分配器
+    void set_allocator(cv::MatAllocator *allocator)
+    {
+        m_allocator.store(allocator);
+    }
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        auto u = m_allocator.load()->allocate(dims, sizes, type, data, step, flags, usage_flags);
+        //释放时经由本分配器,才能扣除存活字节数
+        u->currAllocator = this;
+        u->prevAllocator = this;
+        auto stats = get_thread_request_memory_stats();
+        if (stats != nullptr && (u->flags & cv::UMatData::USER_ALLOCATED) == 0)
+        {
+            ++stats->mat_allocation_count;
+            stats->mat_allocated_bytes += u->size;
+            stats->mat_max_bytes = std::max<std::uint64_t>(stats->mat_max_bytes, u->size);
+            stats->mat_live_bytes += u->size;
+            stats->mat_peak_bytes = std::max<std::uint64_t>(stats->mat_peak_bytes, std::max<std::int64_t>(0, stats->mat_live_bytes));
+        }
+        return u;
+    }
+    bool allocate(cv::UMatData *data, cv::AccessFlag access_flags, cv::UMatUsageFlags usage_flags) const override
+    {
+        return m_allocator.load()->allocate(data, access_flags, usage_flags);
+    }
+    void deallocate(cv::UMatData *data) const override
+    {
+        auto stats = get_thread_request_memory_stats();
+        if (stats != nullptr && data != nullptr && (data->flags & cv::UMatData::USER_ALLOCATED) == 0)
+        {
+            stats->mat_live_bytes -= data->size;
+        }
+        m_allocator.load()->deallocate(data);
+    }
+
+protected:
+    std::atomic<cv::MatAllocator *> m_allocator;
+};
+
+//json节点数,对象与数组本身也算一个节点
+inline std::uint64_t count_json_nodes(const configor::json &obj)
+{
+    std::uint64_t count = 1;
+    if (obj.is_object() || obj.is_array())
+    {
+        for (auto iter = obj.begin(); iter != obj.end(); iter++)
+        {
+            count += count_json_nodes(iter.value());
+        }
+    }
+    return count;
+}
+
+//以下记录函数在没有RequestMemoryScope时直接返回
+inline void record_json_nodes(const configor::json &obj)
+{
+    auto stats = get_thread_request_memory_stats();
+    if (stats != nullptr)
+    {
+        stats->json_node_count += count_json_nodes(obj);
+    }
+}
+
+inline void record_draw(DrawLevel level)
+{
+    auto stats = get_thread_request_memory_stats();
+    if (stats != nullptr)
+    {
+        ++stats->draw_counts[(int)level];
+    }
+}
+
+inline void record_comments(
+    const std::unordered_map<std::string, std::string> &comment_items,
+    const std::unordered_map<std::string, std::vector<std::string>> &sound_items)
+{
+    auto stats = get_thread_request_memory_stats();
+    if (stats == nullptr)
+    {
+        return;
+    }
+    for (auto &[key, comment] : comment_items)
+    {
+        stats->comment_bytes += comment.size();
+    }
+    for (auto &[key, sounds] : sound_items)
+    {
+        for (auto &sound : sounds)
+        {
+            stats->sound_bytes += sound.size();
+        }
+    }
+}
+#endif
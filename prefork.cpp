@@ -0,0 +1,381 @@
+//预先fork的评测服务:管理进程建好参考字库后fork出工作进程,各工作进程共用只读字库
+//用法: prefork --socket path --references corpus.jsonl [--workers N] [--config config_file] [--mat-pool 0|1]
+//--references中每条记录的标准字与配置加入字库,config_line为空时使用--config
+//各工作进程同时poll监听套接字与已接受的连接,连接可读时处理其一个请求,请求与响应格式与daemon相同
+//保持不关的长连接不会占住工作进程
+//工作进程退出时管理进程fork新的进程,字库已在管理进程中建好,不需重建
+//工作进程启动后很快退出时按指数退避延迟重启,避免启动即崩溃的进程被反复fork
+//收到SIGINT或SIGTERM后通知工作进程处理完当前请求后退出,输出各工作进程的内存统计
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "corpus.h"
+#include "manager.h"
+#include "protocol.h"
+
+class PreforkOptions
+{
+public:
+    std::string socket_path;
+    std::string references_path;
+    int worker_count = 4;
+    std::string config_line;
+    bool is_mat_pool = false;
+};
+
+volatile sig_atomic_t is_stopping = 0;
+
+//工作进程运行不到该时长就退出视为启动失败
+const auto min_worker_uptime = std::chrono::seconds(1);
+const auto first_restart_delay = std::chrono::milliseconds(100);
+const auto max_restart_delay = std::chrono::milliseconds(10000);
+
+void handle_signal(int)
+{
+    is_stopping = 1;
+}
+
+//不设SA_RESTART,阻塞的waitpid与poll被信号打断后检查is_stopping
+void install_signal_handlers()
+{
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+}
+
+//处理连接上的一个请求,连接关闭或出错时返回false
+bool serve_request(int fd, Manager &manager, const PreforkOptions &options)
+{
+    std::string payload;
+    try
+    {
+        if (!read_frame(fd, payload))
+        {
+            return false;
+        }
+        ScoreEnvelope envelope;
+        try
+        {
+            envelope = parse_score_envelope(payload);
+        }
+        catch (const std::exception &e)
+        {
+            return write_frame(fd, dump_score_response(0, ResultFormat::json, EvaluateResult(), std::string("bad request: ") + e.what()));
+        }
+        if (envelope.request.config_line.empty())
+        {
+            envelope.request.config_line = options.config_line;
+        }
+        EvaluateResult result;
+        std::string error;
+        try
+        {
+            result = manager.evaluate(envelope.request, envelope.flags);
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+        }
+        return write_frame(fd, dump_score_response(envelope.id, envelope.format, result, error));
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "connection closed: %s\n", e.what());
+        return false;
+    }
+}
+
+//工作进程:使用继承的字库,配置与标准字不在字库中时退回Manager自己的参考字缓存
+//poll_fds[0]为监听套接字,其余为本进程接受的连接;每轮每个可读的连接处理一个请求
+void run_worker(int listen_fd, std::shared_ptr<const ReferenceStore> store, const PreforkOptions &options)
+{
+    Manager manager{Config()};
+    manager.init();
+    manager.set_reference_cache(true);
+    manager.set_reference_store(store);
+    manager.set_mat_pool(options.is_mat_pool);
+    std::vector<pollfd> poll_fds{{listen_fd, POLLIN, 0}};
+    while (!is_stopping)
+    {
+        if (::poll(poll_fds.data(), poll_fds.size(), 200) <= 0)
+        {
+            continue;
+        }
+        auto connection_count = poll_fds.size();
+        if ((poll_fds[0].revents & POLLIN) != 0)
+        {
+            //监听套接字为非阻塞,其他工作进程先取走连接时返回EAGAIN
+            auto fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                poll_fds.push_back({fd, POLLIN, 0});
+            }
+        }
+        for (auto i = 1; i < connection_count; ++i)
+        {
+            if (poll_fds[i].revents == 0)
+            {
+                continue;
+            }
+            if (is_stopping || !serve_request(poll_fds[i].fd, manager, options))
+            {
+                ::close(poll_fds[i].fd);
+                poll_fds[i].fd = -1;
+            }
+        }
+        poll_fds.erase(std::remove_if(poll_fds.begin() + 1, poll_fds.end(), [](const pollfd &poll_fd)
+                                      { return poll_fd.fd < 0; }),
+                       poll_fds.end());
+    }
+    for (auto i = 1; i < poll_fds.size(); ++i)
+    {
+        ::close(poll_fds[i].fd);
+    }
+}
+
+pid_t fork_worker(int listen_fd, std::shared_ptr<const ReferenceStore> store, const PreforkOptions &options)
+{
+    auto pid = ::fork();
+    if (pid == 0)
+    {
+        run_worker(listen_fd, store, options);
+        std::fflush(stderr);
+        ::_exit(0);
+    }
+    return pid;
+}
+
+//从/proc/pid/smaps_rollup读取Pss与私有页面(kB),用于确认字库没有随工作进程复制
+configor::json get_process_memory(pid_t pid)
+{
+    configor::json res;
+    res["pid"] = (long long)pid;
+    std::ifstream file("/proc/" + std::to_string(pid) + "/smaps_rollup");
+    std::string line;
+    long long private_kb = 0;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string name;
+        long long value = 0;
+        stream >> name >> value;
+        if (name == "Rss:" || name == "Pss:")
+        {
+            res[name == "Rss:" ? "rss_kb" : "pss_kb"] = value;
+        }
+        else if (name == "Private_Clean:" || name == "Private_Dirty:")
+        {
+            private_kb += value;
+        }
+    }
+    res["private_kb"] = private_kb;
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    PreforkOptions options;
+    for (auto i = 1; i + 1 < argc; i += 2)
+    {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+        if (name == "--socket")
+        {
+            options.socket_path = value;
+        }
+        else if (name == "--references")
+        {
+            options.references_path = value;
+        }
+        else if (name == "--workers")
+        {
+            options.worker_count = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--config")
+        {
+            std::ifstream config_file(value);
+            std::stringstream config_stream;
+            config_stream << config_file.rdbuf();
+            options.config_line = config_stream.str();
+        }
+        else if (name == "--mat-pool")
+        {
+            options.is_mat_pool = value != "0";
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", name.c_str());
+            return 1;
+        }
+    }
+    if (options.socket_path.empty() || options.references_path.empty())
+    {
+        std::fprintf(stderr, "usage: %s --socket path --references corpus.jsonl [--workers N] [--config config_file] [--mat-pool 0|1]\n", argv[0]);
+        return 1;
+    }
+
+    //工作进程由单线程的管理进程fork,建库时不启用OpenCV线程池
+    cv::setNumThreads(0);
+    auto begin = std::chrono::steady_clock::now();
+    auto store = std::make_shared<ReferenceStore>();
+    auto skipped_count = 0;
+    {
+        Manager manager{Config()};
+        manager.init();
+        CorpusReader reader(options.references_path);
+        CorpusRecord record;
+        int index = 0;
+        while (reader.next(record, index))
+        {
+            try
+            {
+                auto config_line = record.request.config_line.empty() ? options.config_line : record.request.config_line;
+                manager.add_reference(*store, config_line, record.request.standard_lines);
+            }
+            catch (const std::exception &e)
+            {
+                std::fprintf(stderr, "reference %d skipped: %s\n", index, e.what());
+                ++skipped_count;
+            }
+        }
+    }
+    auto build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    std::shared_ptr<const ReferenceStore> shared_store = store;
+    store.reset();
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (options.socket_path.size() >= sizeof(address.sun_path))
+    {
+        std::fprintf(stderr, "socket path too long\n");
+        return 1;
+    }
+    std::strcpy(address.sun_path, options.socket_path.c_str());
+    auto listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(options.socket_path.c_str());
+    if (listen_fd < 0 || ::bind(listen_fd, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(listen_fd, 128) != 0)
+    {
+        std::perror("listen");
+        return 1;
+    }
+    ::fcntl(listen_fd, F_SETFL, ::fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+    install_signal_handlers();
+
+    std::map<pid_t, int> workers; //工作进程与其序号
+    std::vector<std::chrono::steady_clock::time_point> start_times(options.worker_count);
+    std::vector<int> failure_counts(options.worker_count, 0); //各序号连续启动失败的次数
+    for (auto i = 0; i < options.worker_count; ++i)
+    {
+        auto pid = fork_worker(listen_fd, shared_store, options);
+        if (pid < 0)
+        {
+            std::perror("fork");
+            is_stopping = 1;
+            break;
+        }
+        workers[pid] = i;
+        start_times[i] = std::chrono::steady_clock::now();
+    }
+    auto restart_count = 0;
+    while (!is_stopping)
+    {
+        int status;
+        auto pid = ::waitpid(-1, &status, 0);
+        if (pid <= 0)
+        {
+            continue;
+        }
+        auto iter = workers.find(pid);
+        if (iter == workers.end())
+        {
+            continue;
+        }
+        auto slot = iter->second;
+        workers.erase(iter);
+        if (is_stopping)
+        {
+            break;
+        }
+        std::fprintf(stderr, "worker %d (pid %d) exited with status %d, restarting\n", slot, (int)pid, status);
+        if (std::chrono::steady_clock::now() - start_times[slot] < min_worker_uptime)
+        {
+            ++failure_counts[slot];
+        }
+        else
+        {
+            failure_counts[slot] = 0;
+        }
+        pid_t new_pid = -1;
+        while (!is_stopping)
+        {
+            if (failure_counts[slot] > 0)
+            {
+                //连续失败时延迟加倍,sleep被信号打断后检查is_stopping
+                auto delay = std::min<std::chrono::milliseconds>(first_restart_delay * (1LL << std::min(failure_counts[slot] - 1, 16)), max_restart_delay);
+                std::fprintf(stderr, "worker %d failed %d times in a row, restarting in %lld ms\n", slot, failure_counts[slot], (long long)delay.count());
+                timespec duration{(time_t)(delay.count() / 1000), (long)(delay.count() % 1000) * 1000000};
+                ::nanosleep(&duration, nullptr);
+                if (is_stopping)
+                {
+                    break;
+                }
+            }
+            new_pid = fork_worker(listen_fd, shared_store, options);
+            if (new_pid > 0)
+            {
+                break;
+            }
+            std::perror("fork");
+            ++failure_counts[slot];
+        }
+        if (new_pid > 0)
+        {
+            workers[new_pid] = slot;
+            start_times[slot] = std::chrono::steady_clock::now();
+            ++restart_count;
+        }
+    }
+
+    std::vector<configor::json> worker_memory;
+    for (auto &item : workers)
+    {
+        worker_memory.push_back(get_process_memory(item.first));
+        ::kill(item.first, SIGTERM);
+    }
+    for (auto &item : workers)
+    {
+        ::waitpid(item.first, nullptr, 0);
+    }
+    ::close(listen_fd);
+    ::unlink(options.socket_path.c_str());
+
+    configor::json res;
+    res["config_count"] = (long long)shared_store->get_config_count();
+    res["reference_count"] = (long long)shared_store->get_entry_count();
+    res["skipped_count"] = skipped_count;
+    res["build_ms"] = build_ms;
+    res["restart_count"] = restart_count;
+    res["supervisor"] = get_process_memory(::getpid());
+    res["workers"] = worker_memory;
+    std::printf("%s\n", res.dump().c_str());
+    return 0;
+}
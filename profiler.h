@@ -0,0 +1,341 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "deadline.h"
+#include "trace.h"
+
+//评测的各阶段
+enum class Stage
+{
+    config_parse,    // Config::parse_data_1_0
+    segment_load,    // load_from_content
+    stroke_map,      // get_stroke_map
+    stroke_match,    // StrokeMapper::map
+    character_check, // CharacterVerifier::check
+    struction_group, // StructionGrouper::group
+    draw,            //画整字图
+    geometry,        // get_position_size_info*, get_angle_info_half
+    stroke_score,    // score(Stroke...)
+    struction_score, // score(Struction...)
+    character_score, // score(Character...)
+    base_score,      // score_base
+    parse_to_old,    // parse_to_old
+    count,
+};
+constexpr int STAGE_COUNT = (int)Stage::count;
+
+inline const char *get_stage_name(Stage stage)
+{
+    static const char *names[] = {
+        "config_parse", "segment_load", "stroke_map", "stroke_match", "character_check", "struction_group", "draw", "geometry",
+        "stroke_score", "struction_score", "character_score", "base_score", "parse_to_old"};
+    return names[(int)stage];
+}
+
+/**
+ * @brief HDR风格的对数-线性直方图,单位纳秒
+ *
+ * 每个2的幂区间再等分为2^SUB_BUCKET_BITS个子桶,相对误差约3%,最大记录约68秒
+ * 每个线程只写自己的直方图,写入不加锁也不用原子读改写
+ */
+class LatencyHistogram
+{
+public:
+    constexpr static int SUB_BUCKET_BITS = 5;
+    constexpr static int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    constexpr static int MAX_VALUE_BITS = 36;
+    constexpr static int BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKET_COUNT;
+
+    static int get_index(std::uint64_t value)
+    {
+        value = std::min(value, ((std::uint64_t)1 << MAX_VALUE_BITS) - 1);
+        if (value < SUB_BUCKET_COUNT)
+        {
+            return (int)value;
+        }
+        auto exponent = 63 - __builtin_clzll(value);
+        auto bucket = exponent - SUB_BUCKET_BITS + 1;
+        return bucket * SUB_BUCKET_COUNT + (int)(value >> (bucket - 1)) - SUB_BUCKET_COUNT;
+    }
+    //下标对应区间的下界
+    static std::uint64_t get_value(int index)
+    {
+        if (index < SUB_BUCKET_COUNT)
+        {
+            return index;
+        }
+        auto bucket = index / SUB_BUCKET_COUNT;
+        auto sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        return (std::uint64_t)sub_bucket << (bucket - 1);
+    }
+    void record(std::uint64_t value)
+    {
+        add(m_counts[get_index(value)], 1);
+        add(m_total_count, 1);
+        add(m_sum, value);
+        if (value > m_max.load(std::memory_order_relaxed))
+        {
+            m_max.store(value, std::memory_order_relaxed);
+        }
+    }
+    void reset()
+    {
+        for (auto &count : m_counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        m_total_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+protected:
+    //单写者,load+store即可,读者读到的是某一时刻的值
+    static void add(std::atomic<std::uint64_t> &counter, std::uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    std::atomic<std::uint64_t> m_counts[BUCKET_COUNT] = {};
+    std::atomic<std::uint64_t> m_total_count{0};
+    std::atomic<std::uint64_t> m_sum{0};
+    std::atomic<std::uint64_t> m_max{0};
+    friend class HistogramSnapshot;
+};
+
+//多个线程直方图合并后的快照
+class HistogramSnapshot
+{
+public:
+    std::string name;
+    std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(LatencyHistogram::BUCKET_COUNT, 0);
+    std::uint64_t total_count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    void merge(const LatencyHistogram &histogram)
+    {
+        for (auto i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+        {
+            counts[i] += histogram.m_counts[i].load(std::memory_order_relaxed);
+        }
+        total_count += histogram.m_total_count.load(std::memory_order_relaxed);
+        sum += histogram.m_sum.load(std::memory_order_relaxed);
+        max = std::max(max, histogram.m_max.load(std::memory_order_relaxed));
+    }
+    void merge(const HistogramSnapshot &snapshot)
+    {
+        for (auto i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+        {
+            counts[i] += snapshot.counts[i];
+        }
+        total_count += snapshot.total_count;
+        sum += snapshot.sum;
+        max = std::max(max, snapshot.max);
+    }
+    double mean() const
+    {
+        return total_count == 0 ? 0.0 : (double)sum / total_count;
+    }
+    /**
+     * @brief 分位数,返回所在子桶的下界(纳秒)
+     *
+     * @param quantile 0-1,例如0.99
+     */
+    std::uint64_t percentile(double quantile) const
+    {
+        if (total_count == 0)
+        {
+            return 0;
+        }
+        auto target = (std::uint64_t)(quantile * total_count);
+        target = std::max<std::uint64_t>(1, std::min(target, total_count));
+        std::uint64_t cumulative = 0;
+        for (auto i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+        {
+            cumulative += counts[i];
+            if (cumulative >= target)
+            {
+                return std::min(LatencyHistogram::get_value(i), max);
+            }
+        }
+        return max;
+    }
+};
+
+//一个线程的各阶段直方图
+class StageProfile
+{
+public:
+    LatencyHistogram histograms[STAGE_COUNT];
+};
+
+/**
+ * @brief 各阶段耗时统计,每个线程第一次记录时注册自己的StageProfile
+ *
+ * 只有注册时加锁,记录时无锁;线程退出后其数据仍保留在快照中
+ */
+class Profiler
+{
+public:
+    static Profiler &instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+    bool is_enabled() const
+    {
+        return m_is_enabled.load(std::memory_order_relaxed);
+    }
+    void set_enabled(bool is_enabled)
+    {
+        m_is_enabled.store(is_enabled, std::memory_order_relaxed);
+    }
+    void record(Stage stage, std::uint64_t nanoseconds)
+    {
+        get_thread_profile().histograms[(int)stage].record(nanoseconds);
+    }
+    //各阶段快照,顺序与Stage一致
+    std::vector<HistogramSnapshot> snapshot()
+    {
+        std::vector<HistogramSnapshot> snapshots(STAGE_COUNT);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto i = 0; i < STAGE_COUNT; ++i)
+        {
+            snapshots[i].name = get_stage_name((Stage)i);
+            for (auto &profile : m_profiles)
+            {
+                snapshots[i].merge(profile->histograms[i]);
+            }
+        }
+        return snapshots;
+    }
+    //清零,与正在进行的记录并发时可能丢失少量样本
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &profile : m_profiles)
+        {
+            for (auto &histogram : profile->histograms)
+            {
+                histogram.reset();
+            }
+        }
+    }
+
+protected:
+    StageProfile &get_thread_profile()
+    {
+        thread_local std::shared_ptr<StageProfile> profile;
+        if (!profile)
+        {
+            profile = std::make_shared<StageProfile>();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_profiles.push_back(profile);
+        }
+        return *profile;
+    }
+    std::atomic<bool> m_is_enabled{true};
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<StageProfile>> m_profiles;
+};
+
+//一次请求内各阶段的累计耗时与调用次数
+class RequestStageTimes
+{
+public:
+    std::uint64_t nanoseconds[STAGE_COUNT] = {};
+    int counts[STAGE_COUNT] = {};
+};
+
+//当前线程正在累计的请求,为空时不累计
+inline RequestStageTimes *&get_thread_request_stage_times()
+{
+    thread_local RequestStageTimes *times = nullptr;
+    return times;
+}
+
+//作用域内当前线程的StageTimer同时累计到times,可嵌套
+class RequestStageScope
+{
+public:
+    RequestStageScope(RequestStageTimes *times) : m_previous(get_thread_request_stage_times())
+    {
+        get_thread_request_stage_times() = times;
+    }
+    ~RequestStageScope()
+    {
+        get_thread_request_stage_times() = m_previous;
+    }
+    RequestStageScope(const RequestStageScope &) = delete;
+    RequestStageScope &operator=(const RequestStageScope &) = delete;
+
+protected:
+    RequestStageTimes *m_previous;
+};
+
+//作用域计时,析构时记录到Profiler与当前请求,开启轨迹时同时输出开始与结束事件
+//每个阶段开始前是一个取消检查点,当前请求超时或被取消时抛出DeadlineException
+class StageTimer
+{
+public:
+    StageTimer(Stage stage)
+        : m_stage(stage), m_is_profiled(Profiler::instance().is_enabled()), m_is_traced(Tracer::instance().is_enabled()),
+          m_request_times(get_thread_request_stage_times())
+    {
+        check_cancellation();
+        if (m_is_traced)
+        {
+            m_is_traced = Tracer::instance().begin("stage", get_stage_name(stage));
+        }
+        if (m_is_profiled || m_request_times != nullptr)
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+    ~StageTimer()
+    {
+        if (m_is_traced)
+        {
+            Tracer::instance().end("stage");
+        }
+        if (m_is_profiled || m_request_times != nullptr)
+        {
+            auto duration = std::chrono::steady_clock::now() - m_start;
+            auto nanoseconds = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+            if (m_is_profiled)
+            {
+                Profiler::instance().record(m_stage, nanoseconds);
+            }
+            if (m_request_times != nullptr)
+            {
+                m_request_times->nanoseconds[(int)m_stage] += nanoseconds;
+                ++m_request_times->counts[(int)m_stage];
+            }
+        }
+    }
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+protected:
+    Stage m_stage;
+    bool m_is_profiled;
+    bool m_is_traced;
+    RequestStageTimes *m_request_times;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+//计时执行func并返回其结果,便于包住结构化绑定的右侧
+template <typename Func>
+auto time_stage(Stage stage, Func &&func)
+{
+    StageTimer timer(stage);
+    return func();
+}
+#endif
@@ -0,0 +1,640 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "configor/json.hpp"
+#include "corpus.h"
+#include "request.h"
+#include "request_hash.h"
+
+/**
+ * 评测服务的消息格式
+ *
+ * 每帧为4字节小端长度加负载,负载不超过MAX_FRAME_SIZE
+ * 请求负载为json:{"id":1,"flags":3,"format":"json","request":{...}},request与语料记录的字段相同
+ * 响应负载首字节为格式:'J'之后为json {"id","error","detail","red_index_array","holistic_score"},
+ * 'B'之后为CompactResult的二进制布局
+ */
+constexpr std::uint32_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+//完整写出size字节,失败(对端关闭)时返回false
+inline bool write_full(int fd, const void *data, std::size_t size)
+{
+    auto bytes = (const char *)data;
+    while (size > 0)
+    {
+        auto count = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+//完整读入size字节,对端关闭或出错时返回false
+inline bool read_full(int fd, void *data, std::size_t size)
+{
+    auto bytes = (char *)data;
+    while (size > 0)
+    {
+        auto count = ::recv(fd, bytes, size, 0);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+inline bool write_frame(int fd, const std::string &payload)
+{
+    auto size = (std::uint32_t)payload.size();
+    unsigned char header[4] = {(unsigned char)size, (unsigned char)(size >> 8), (unsigned char)(size >> 16), (unsigned char)(size >> 24)};
+    return write_full(fd, header, 4) && write_full(fd, payload.data(), payload.size());
+}
+
+//帧长超过MAX_FRAME_SIZE时抛出异常,连接应关闭
+inline bool read_frame(int fd, std::string &payload)
+{
+    unsigned char header[4];
+    if (!read_full(fd, header, 4))
+    {
+        return false;
+    }
+    auto size = (std::uint32_t)header[0] | ((std::uint32_t)header[1] << 8) | ((std::uint32_t)header[2] << 16) | ((std::uint32_t)header[3] << 24);
+    if (size > MAX_FRAME_SIZE)
+    {
+        throw std::runtime_error("frame too large: " + std::to_string(size));
+    }
+    payload.resize(size);
+    return read_full(fd, &payload[0], size);
+}
+
+enum class ResultFormat
+{
+    json,
+    binary,
+};
+
+//一次评测请求及其编号,同一连接上的响应可能乱序,按id对应
+class ScoreEnvelope
+{
+public:
+    std::uint32_t id = 0;
+    int flags = EVALUATE_DETAIL | EVALUATE_HOLISTIC;
+    ResultFormat format = ResultFormat::json;
+    ScoreRequest request;
+    RequestHash request_hash; //request的规范哈希,解析请求时计算,见hash_score_request
+};
+
+inline std::string dump_score_envelope(const ScoreEnvelope &envelope)
+{
+    configor::json res;
+    res["id"] = (long long)envelope.id;
+    res["flags"] = envelope.flags;
+    res["format"] = envelope.format == ResultFormat::binary ? "binary" : "json";
+    res["request"] = request_to_json(envelope.request);
+    return res.dump();
+}
+
+inline RequestHash hash_score_request(const ScoreRequest &request);
+
+inline ScoreEnvelope parse_score_envelope(const std::string &payload)
+{
+    auto obj = configor::json::parse(payload);
+    ScoreEnvelope envelope;
+    envelope.id = (std::uint32_t)obj["id"].as_integer();
+    envelope.flags = obj["flags"].is_null() ? envelope.flags : (int)obj["flags"].as_integer();
+    envelope.format = !obj["format"].is_null() && obj["format"].as_string() == "binary" ? ResultFormat::binary : ResultFormat::json;
+    envelope.request = request_from_json(obj["request"]);
+    envelope.request_hash = hash_score_request(envelope.request);
+    return envelope;
+}
+
+//详细评测结果中的数值字段,顺序即二进制布局中的顺序
+inline const std::vector<std::string> &get_compact_number_keys()
+{
+    static const std::vector<std::string> keys{
+        "score", "centerOfGravityType", "centerOfGravityScore", "error", "fontSize", "fontSizeScore",
+        "fountScore", "fountType", "spacingStructureScore", "strokeCountDiff", "strokeCountScore",
+        "strokeLengthScore", "strokeOrderScore", "z100speedScore", "z101structionScore"};
+    return keys;
+}
+
+//详细评测结果中的评语字段
+inline const std::vector<std::string> &get_compact_text_keys()
+{
+    static const std::vector<std::string> keys{
+        "spacingStructure", "strokeCount", "strokeLength", "strokeOrder", "z102struction", "speed"};
+    return keys;
+}
+
+/**
+ * @brief 紧凑的评测结果:详细评测的数值与评语字段、红色笔画下标与整体评分
+ *
+ * 不含语音数组与debug,需要完整结果时使用json格式
+ */
+class CompactResult
+{
+public:
+    std::uint32_t id = 0;
+    std::string error; //评测抛出异常时的what()
+    bool has_detail = false;
+    bool has_holistic = false;
+    double holistic_score = 0.0;
+    std::vector<double> numbers;    //与get_compact_number_keys对应
+    std::vector<std::string> texts; //与get_compact_text_keys对应
+    std::vector<int> red_index_array;
+
+    static CompactResult from_evaluate_result(std::uint32_t id, const EvaluateResult &result)
+    {
+        CompactResult compact;
+        compact.id = id;
+        compact.has_detail = result.has_detail;
+        compact.has_holistic = result.has_holistic;
+        compact.holistic_score = result.holistic_score;
+        compact.red_index_array = result.red_index_array;
+        if (result.has_detail)
+        {
+            auto detail = result.detail;
+            for (auto &key : get_compact_number_keys())
+            {
+                compact.numbers.push_back(detail[key].is_number() ? detail[key].as_float() : 0.0);
+            }
+            for (auto &key : get_compact_text_keys())
+            {
+                compact.texts.push_back(detail[key].is_string() ? detail[key].as_string() : "");
+            }
+        }
+        return compact;
+    }
+    //还原为详细评测json中的对应字段
+    configor::json to_detail_json() const
+    {
+        configor::json res;
+        auto &number_keys = get_compact_number_keys();
+        for (auto i = 0; i < numbers.size() && i < number_keys.size(); ++i)
+        {
+            if (numbers[i] == std::floor(numbers[i]))
+            {
+                res[number_keys[i]] = (long long)numbers[i];
+            }
+            else
+            {
+                res[number_keys[i]] = numbers[i];
+            }
+        }
+        auto &text_keys = get_compact_text_keys();
+        for (auto i = 0; i < texts.size() && i < text_keys.size(); ++i)
+        {
+            res[text_keys[i]] = texts[i];
+        }
+        return res;
+    }
+};
+
+//小端二进制写入
+class BinaryWriter
+{
+public:
+    std::string data;
+    void write_u32(std::uint32_t value)
+    {
+        for (auto i = 0; i < 4; ++i)
+        {
+            data.push_back((char)(value >> (8 * i)));
+        }
+    }
+    void write_f64(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, 8);
+        for (auto i = 0; i < 8; ++i)
+        {
+            data.push_back((char)(bits >> (8 * i)));
+        }
+    }
+    void write_string(const std::string &value)
+    {
+        write_u32((std::uint32_t)value.size());
+        data += value;
+    }
+};
+
+//只计算二进制布局的字节数,用于先在共享内存中预留空间再原地写入
+class BinarySizer
+{
+public:
+    std::size_t size = 0;
+    void write_u32(std::uint32_t)
+    {
+        size += 4;
+    }
+    void write_f64(double)
+    {
+        size += 8;
+    }
+    void write_string(const std::string &value)
+    {
+        size += 4 + value.size();
+    }
+};
+
+//写入调用方提供的缓冲区,缓冲区大小由BinarySizer预先计算
+class BufferWriter
+{
+public:
+    BufferWriter(char *data) : m_data(data)
+    {
+    }
+    void write_u32(std::uint32_t value)
+    {
+        for (auto i = 0; i < 4; ++i)
+        {
+            m_data[m_offset++] = (char)(value >> (8 * i));
+        }
+    }
+    void write_f64(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, 8);
+        for (auto i = 0; i < 8; ++i)
+        {
+            m_data[m_offset++] = (char)(bits >> (8 * i));
+        }
+    }
+    void write_string(const std::string &value)
+    {
+        write_u32((std::uint32_t)value.size());
+        std::memcpy(m_data + m_offset, value.data(), value.size());
+        m_offset += value.size();
+    }
+
+protected:
+    char *m_data;
+    std::size_t m_offset = 0;
+};
+
+class BinaryReader
+{
+public:
+    BinaryReader(const char *data, std::size_t size) : m_data(data), m_size(size)
+    {
+    }
+    std::uint32_t read_u32()
+    {
+        check(4);
+        std::uint32_t value = 0;
+        for (auto i = 0; i < 4; ++i)
+        {
+            value |= (std::uint32_t)(unsigned char)m_data[m_offset + i] << (8 * i);
+        }
+        m_offset += 4;
+        return value;
+    }
+    double read_f64()
+    {
+        check(8);
+        std::uint64_t bits = 0;
+        for (auto i = 0; i < 8; ++i)
+        {
+            bits |= (std::uint64_t)(unsigned char)m_data[m_offset + i] << (8 * i);
+        }
+        m_offset += 8;
+        double value;
+        std::memcpy(&value, &bits, 8);
+        return value;
+    }
+    std::string read_string()
+    {
+        auto size = read_u32();
+        check(size);
+        std::string value(m_data + m_offset, size);
+        m_offset += size;
+        return value;
+    }
+    /**
+     * @brief 读取数组的元素个数,按每个元素至少min_element_size字节检查剩余长度
+     *
+     * 个数来自不可信的输入,检查之后才用于分配
+     */
+    std::uint32_t read_count(std::size_t min_element_size)
+    {
+        auto count = read_u32();
+        check((std::size_t)count * min_element_size);
+        return count;
+    }
+    const char *get_position() const
+    {
+        return m_data + m_offset;
+    }
+
+protected:
+    void check(std::size_t size)
+    {
+        if (size > m_size - m_offset)
+        {
+            throw std::runtime_error("truncated binary result");
+        }
+    }
+    const char *m_data;
+    std::size_t m_size;
+    std::size_t m_offset = 0;
+};
+
+/**
+ * @brief CompactResult的二进制布局
+ *
+ * u32 id, u32 标志(1:详细评测 2:整体评分 4:出错), f64 整体评分, string 错误,
+ * u32 数值个数与各f64, u32 评语个数与各string, u32 红色笔画个数与各u32;string为u32长度加字节
+ * Writer为BinaryWriter、BinarySizer或BufferWriter
+ */
+template <typename Writer>
+void write_compact_result(Writer &writer, const CompactResult &result)
+{
+    writer.write_u32(result.id);
+    writer.write_u32((result.has_detail ? 1 : 0) | (result.has_holistic ? 2 : 0) | (result.error.empty() ? 0 : 4));
+    writer.write_f64(result.holistic_score);
+    writer.write_string(result.error);
+    writer.write_u32((std::uint32_t)result.numbers.size());
+    for (auto number : result.numbers)
+    {
+        writer.write_f64(number);
+    }
+    writer.write_u32((std::uint32_t)result.texts.size());
+    for (auto &text : result.texts)
+    {
+        writer.write_string(text);
+    }
+    writer.write_u32((std::uint32_t)result.red_index_array.size());
+    for (auto index : result.red_index_array)
+    {
+        writer.write_u32((std::uint32_t)index);
+    }
+}
+
+inline CompactResult read_compact_result(BinaryReader &reader)
+{
+    CompactResult result;
+    result.id = reader.read_u32();
+    auto flags = reader.read_u32();
+    result.has_detail = (flags & 1) != 0;
+    result.has_holistic = (flags & 2) != 0;
+    result.holistic_score = reader.read_f64();
+    result.error = reader.read_string();
+    auto number_count = reader.read_u32();
+    for (auto i = 0; i < number_count; ++i)
+    {
+        result.numbers.push_back(reader.read_f64());
+    }
+    auto text_count = reader.read_u32();
+    for (auto i = 0; i < text_count; ++i)
+    {
+        result.texts.push_back(reader.read_string());
+    }
+    auto red_count = reader.read_u32();
+    for (auto i = 0; i < red_count; ++i)
+    {
+        result.red_index_array.push_back((int)reader.read_u32());
+    }
+    return result;
+}
+
+template <typename Writer>
+void write_int_array(Writer &writer, const std::vector<int> &values)
+{
+    writer.write_u32((std::uint32_t)values.size());
+    for (auto value : values)
+    {
+        writer.write_u32((std::uint32_t)value);
+    }
+}
+
+inline std::vector<int> read_int_array(BinaryReader &reader)
+{
+    std::vector<int> values(reader.read_count(4));
+    for (auto &value : values)
+    {
+        value = (int)reader.read_u32();
+    }
+    return values;
+}
+
+/**
+ * @brief ScoreEnvelope的二进制布局,共享内存通道使用,省去json的生成与解析
+ *
+ * u32 id, u32 flags, u32 format(0:json 1:binary),
+ * u32 标准字笔画段个数与各string, u32 手写笔画段个数与各string,
+ * 字信息: string name, string type, 部件下标数组, f64 warp_score,
+ * u32 部件个数与各笔画下标数组, u32 笔画个数与各笔画:string name, u32 order, u32 标志(1:有效 2:跳过 4:可靠), 笔画段下标数组,
+ * string config_line, u32 is_character_right;下标数组为u32个数加各u32
+ * id、flags、format之后的部分即请求的规范布局,其哈希为hash_score_request
+ */
+template <typename Writer>
+void write_score_request(Writer &writer, const ScoreRequest &request)
+{
+    writer.write_u32((std::uint32_t)request.standard_lines.size());
+    for (auto &line : request.standard_lines)
+    {
+        writer.write_string(line);
+    }
+    writer.write_u32((std::uint32_t)request.evaluate_lines.size());
+    for (auto &line : request.evaluate_lines)
+    {
+        writer.write_string(line);
+    }
+    writer.write_string(request.char_info.name);
+    writer.write_string(request.char_info.type);
+    write_int_array(writer, request.char_info.struction_index_array);
+    writer.write_f64(request.char_info.warp_score);
+    writer.write_u32((std::uint32_t)request.struction_info_array.size());
+    for (auto &struction_info : request.struction_info_array)
+    {
+        write_int_array(writer, struction_info.stroke_index_array);
+    }
+    writer.write_u32((std::uint32_t)request.stroke_info_array.size());
+    for (auto &stroke_info : request.stroke_info_array)
+    {
+        writer.write_string(stroke_info.name);
+        writer.write_u32((std::uint32_t)stroke_info.order);
+        writer.write_u32((stroke_info.is_valid ? 1 : 0) | (stroke_info.is_skip ? 2 : 0) | (stroke_info.is_reliable ? 4 : 0));
+        write_int_array(writer, stroke_info.segment_index_array);
+    }
+    writer.write_string(request.config_line);
+    writer.write_u32(request.is_character_right ? 1 : 0);
+}
+
+template <typename Writer>
+void write_score_envelope(Writer &writer, const ScoreEnvelope &envelope)
+{
+    writer.write_u32(envelope.id);
+    writer.write_u32((std::uint32_t)envelope.flags);
+    writer.write_u32(envelope.format == ResultFormat::binary ? 1 : 0);
+    write_score_request(writer, envelope.request);
+}
+
+/**
+ * @brief 请求的规范哈希:以本进程的密钥对write_score_request的布局计算128位SipHash
+ *
+ * 覆盖标准字与手写笔画段、字/部件/笔画信息、config_line与is_character_right,
+ * 同一进程内json与二进制两种请求格式得到相同的值
+ */
+inline RequestHash hash_score_request(const ScoreRequest &request)
+{
+    HashWriter writer;
+    write_score_request(writer, request);
+    return writer.hash.finish();
+}
+
+//请求的哈希直接对读过的请求字节计算,不再重新生成布局
+inline ScoreEnvelope read_score_envelope(BinaryReader &reader)
+{
+    ScoreEnvelope envelope;
+    auto &request = envelope.request;
+    envelope.id = reader.read_u32();
+    envelope.flags = (int)reader.read_u32();
+    envelope.format = reader.read_u32() == 1 ? ResultFormat::binary : ResultFormat::json;
+    auto request_begin = reader.get_position();
+    //各数组的最小元素长度:string与下标数组为4字节的长度或个数,笔画为name、order、标志与下标数组
+    request.standard_lines.resize(reader.read_count(4));
+    for (auto &line : request.standard_lines)
+    {
+        line = reader.read_string();
+    }
+    request.evaluate_lines.resize(reader.read_count(4));
+    for (auto &line : request.evaluate_lines)
+    {
+        line = reader.read_string();
+    }
+    request.char_info.name = reader.read_string();
+    request.char_info.type = reader.read_string();
+    request.char_info.struction_index_array = read_int_array(reader);
+    request.char_info.warp_score = reader.read_f64();
+    request.struction_info_array.resize(reader.read_count(4));
+    for (auto &struction_info : request.struction_info_array)
+    {
+        struction_info.stroke_index_array = read_int_array(reader);
+    }
+    request.stroke_info_array.resize(reader.read_count(16));
+    for (auto &stroke_info : request.stroke_info_array)
+    {
+        stroke_info.name = reader.read_string();
+        stroke_info.order = (int)reader.read_u32();
+        auto flags = reader.read_u32();
+        stroke_info.is_valid = (flags & 1) != 0;
+        stroke_info.is_skip = (flags & 2) != 0;
+        stroke_info.is_reliable = (flags & 4) != 0;
+        stroke_info.segment_index_array = read_int_array(reader);
+    }
+    request.config_line = reader.read_string();
+    request.is_character_right = reader.read_u32() != 0;
+    Hash128 hash;
+    hash.update(request_begin, reader.get_position() - request_begin);
+    envelope.request_hash = hash.finish();
+    return envelope;
+}
+
+//客户端收到的一条响应
+class ScoreResponse
+{
+public:
+    std::uint32_t id = 0;
+    std::string error;
+    EvaluateResult result; //二进制格式时detail只含CompactResult中的字段
+};
+
+inline std::string dump_score_response(std::uint32_t id, ResultFormat format, const EvaluateResult &result, const std::string &error)
+{
+    if (format == ResultFormat::binary)
+    {
+        auto compact = CompactResult::from_evaluate_result(id, result);
+        compact.error = error;
+        BinaryWriter writer;
+        writer.data.push_back('B');
+        write_compact_result(writer, compact);
+        return writer.data;
+    }
+    configor::json res;
+    res["id"] = (long long)id;
+    res["error"] = error;
+    if (result.has_detail)
+    {
+        res["detail"] = result.detail;
+        res["red_index_array"] = result.red_index_array;
+    }
+    if (result.has_holistic)
+    {
+        res["holistic_score"] = result.holistic_score;
+    }
+    return "J" + res.dump();
+}
+
+//data为响应负载,可以直接指向共享内存
+inline ScoreResponse parse_score_response(const char *data, std::size_t size)
+{
+    if (size == 0)
+    {
+        throw std::runtime_error("empty response");
+    }
+    ScoreResponse response;
+    if (data[0] == 'B')
+    {
+        BinaryReader reader(data + 1, size - 1);
+        auto compact = read_compact_result(reader);
+        response.id = compact.id;
+        response.error = compact.error;
+        response.result.has_detail = compact.has_detail;
+        response.result.has_holistic = compact.has_holistic;
+        response.result.holistic_score = compact.holistic_score;
+        response.result.red_index_array = compact.red_index_array;
+        if (compact.has_detail)
+        {
+            response.result.detail = compact.to_detail_json();
+        }
+        return response;
+    }
+    auto obj = configor::json::parse(std::string(data + 1, size - 1));
+    response.id = (std::uint32_t)obj["id"].as_integer();
+    response.error = obj["error"].is_null() ? "" : obj["error"].as_string();
+    if (!obj["detail"].is_null())
+    {
+        response.result.has_detail = true;
+        response.result.detail = obj["detail"];
+        for (auto item : obj["red_index_array"])
+        {
+            response.result.red_index_array.push_back((int)item.as_integer());
+        }
+    }
+    if (!obj["holistic_score"].is_null())
+    {
+        response.result.has_holistic = true;
+        response.result.holistic_score = obj["holistic_score"].as_float();
+    }
+    return response;
+}
+
+inline ScoreResponse parse_score_response(const std::string &payload)
+{
+    return parse_score_response(payload.data(), payload.size());
+}
+#endif
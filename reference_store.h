@@ -0,0 +1,93 @@
+#ifndef REFERENCE_STORE_H
+#define REFERENCE_STORE_H
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "config.h"
+#include "segment.h"
+#include "resample.h"
+
+//参考字库中一个标准字读取好的笔画段
+class ReferenceEntry
+{
+public:
+    std::vector<Segment> segments;
+    std::vector<SegmentPointCount> point_counts;
+};
+
+/**
+ * @brief 只读的参考字库:解析好的配置与读取好的标准字笔画段
+ *
+ * 由Manager::add_reference建立,建好后以shared_ptr<const ReferenceStore>交给各Manager只读使用
+ * 预先fork的工作进程继承建好的字库,字库所在页面只读,由各进程共享而不复制
+ * 标准字笔画段与建库时Manager的重采样设置有关,字库记录该设置,
+ * 重采样设置不同的Manager不取用字库中的笔画段,仍自行读取
+ */
+class ReferenceStore
+{
+public:
+    //配置在字库中的序号,不存在时返回-1
+    int find_config(const std::string &config_line) const
+    {
+        auto iter = m_config_indexes.find(config_line);
+        return iter == m_config_indexes.end() ? -1 : iter->second;
+    }
+    const Config &get_config(int config_index) const
+    {
+        return m_configs[config_index];
+    }
+    //不存在时返回nullptr
+    const ReferenceEntry *find_entry(int config_index, const std::vector<std::string> &standard_lines) const
+    {
+        auto iter = m_entries.find({config_index, standard_lines});
+        return iter == m_entries.end() ? nullptr : &iter->second;
+    }
+    int add_config(const std::string &config_line, Config config)
+    {
+        auto config_index = find_config(config_line);
+        if (config_index >= 0)
+        {
+            return config_index;
+        }
+        m_configs.push_back(std::move(config));
+        m_config_indexes[config_line] = (int)m_configs.size() - 1;
+        return (int)m_configs.size() - 1;
+    }
+    void add_entry(int config_index, std::vector<std::string> standard_lines, ReferenceEntry entry, const ResampleOptions &resample_options)
+    {
+        if (!is_compatible(resample_options))
+        {
+            throw std::runtime_error("reference store was built with different resample options");
+        }
+        m_resample_options = resample_options;
+        m_entries[{config_index, std::move(standard_lines)}] = std::move(entry);
+    }
+    //字库中标准字笔画段的重采样设置,由第一次add_entry确定
+    const ResampleOptions &get_resample_options() const
+    {
+        return m_resample_options;
+    }
+    //库中已有笔画段时重采样设置必须相同
+    bool is_compatible(const ResampleOptions &resample_options) const
+    {
+        return m_entries.empty() || m_resample_options == resample_options;
+    }
+    std::size_t get_config_count() const
+    {
+        return m_configs.size();
+    }
+    std::size_t get_entry_count() const
+    {
+        return m_entries.size();
+    }
+
+protected:
+    std::unordered_map<std::string, int> m_config_indexes;
+    std::vector<Config> m_configs;
+    std::map<std::pair<int, std::vector<std::string>>, ReferenceEntry> m_entries;
+    ResampleOptions m_resample_options;
+};
+#endif
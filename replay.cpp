@@ -0,0 +1,317 @@
+//语料回放:以指定并发把语料逐条送入score(...)与double score(...)
+//输出吞吐、延迟分位数与峰值内存,并与语料中的基准输出逐字段比较
+//用法: replay <corpus.jsonl> [--threads N] [--config config_file] [--mode detail|holistic|both]
+//             [--epsilon e] [--write-golden out.jsonl] [--max-report N] [--trace trace.json]
+//--write-golden把本次结果作为基准写出,输出语料与输入顺序一致,用于在优化前生成基准
+//--trace开启执行轨迹,结束后写出Chrome trace json,可查看各线程的空闲与负载不均
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "corpus.h"
+#include "manager.h"
+
+class ReplayOptions
+{
+public:
+    std::string corpus_path;
+    std::string config_line; //非空时覆盖语料中的config_line
+    int thread_count = 1;
+    bool is_detail = true;
+    bool is_holistic = true;
+    double epsilon = 1e-9;
+    std::string golden_path;
+    int max_report = 20;
+    std::string trace_path;
+};
+
+//一个线程的统计,结束后合并
+class ReplayWorkerStats
+{
+public:
+    std::unique_ptr<LatencyHistogram> detail_histogram = std::make_unique<LatencyHistogram>();
+    std::unique_ptr<LatencyHistogram> holistic_histogram = std::make_unique<LatencyHistogram>();
+    int record_count = 0;
+    int compared_count = 0;
+    int mismatch_count = 0;
+    int error_count = 0;
+};
+
+/**
+ * @brief 按行号顺序写出基准语料,先完成的记录暂存到前面的记录写出为止
+ *
+ */
+class GoldenWriter
+{
+public:
+    GoldenWriter(const std::string &path, bool is_with_config) : m_file(path), m_is_with_config(is_with_config)
+    {
+        if (!m_file.is_open())
+        {
+            throw std::runtime_error("cannot open golden output " + path);
+        }
+    }
+    void write(int index, const CorpusRecord &record)
+    {
+        auto line = dump_corpus_record(record, m_is_with_config);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending[index] = std::move(line);
+        for (auto iter = m_pending.find(m_next_index); iter != m_pending.end(); iter = m_pending.find(m_next_index))
+        {
+            m_file << iter->second << '\n';
+            m_pending.erase(iter);
+            ++m_next_index;
+        }
+    }
+
+protected:
+    std::ofstream m_file;
+    bool m_is_with_config;
+    std::mutex m_mutex;
+    std::map<int, std::string> m_pending;
+    int m_next_index = 0;
+};
+
+std::mutex report_mutex;
+std::atomic<int> reported_count{0};
+
+void report_differences(const ReplayOptions &options, int index, const std::vector<std::string> &differences)
+{
+    std::lock_guard<std::mutex> lock(report_mutex);
+    for (auto &difference : differences)
+    {
+        if (reported_count >= options.max_report)
+        {
+            return;
+        }
+        ++reported_count;
+        std::fprintf(stderr, "record %d: %s\n", index, difference.c_str());
+    }
+}
+
+void replay_worker(const ReplayOptions &options, CorpusReader &reader, GoldenWriter *golden_writer, ReplayWorkerStats &stats)
+{
+    Manager manager{Config()};
+    manager.init();
+    CorpusRecord record;
+    int index = 0;
+    while (reader.next(record, index))
+    {
+        auto &request = record.request;
+        if (!options.config_line.empty())
+        {
+            request.config_line = options.config_line;
+        }
+        configor::json detail;
+        std::vector<int> red_index_array;
+        double holistic_score = 0.0;
+        std::string detail_error;
+        std::string holistic_error;
+        if (options.is_detail)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            try
+            {
+                std::tie(detail, red_index_array) = manager.score(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.config_line, request.is_character_right);
+            }
+            catch (const std::exception &e)
+            {
+                detail_error = e.what();
+                ++stats.error_count;
+            }
+            stats.detail_histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+        }
+        if (options.is_holistic)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            try
+            {
+                holistic_score = manager.score(request.standard_lines, request.evaluate_lines, request.char_info, request.struction_info_array, request.stroke_info_array, request.config_line);
+            }
+            catch (const std::exception &e)
+            {
+                holistic_error = e.what();
+                ++stats.error_count;
+            }
+            stats.holistic_histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+        }
+        ++stats.record_count;
+
+        if (record.has_golden)
+        {
+            std::vector<std::string> differences;
+            if (options.is_detail)
+            {
+                if (detail_error != record.golden_detail_error)
+                {
+                    differences.push_back("detail_error: \"" + record.golden_detail_error + "\" != \"" + detail_error + "\"");
+                }
+                else if (detail_error.empty())
+                {
+                    diff_json(record.golden_detail, detail, "detail", options.epsilon, differences);
+                    if (red_index_array != record.golden_red_index_array)
+                    {
+                        differences.push_back("red_index_array: " + configor::json(record.golden_red_index_array).dump() + " != " + configor::json(red_index_array).dump());
+                    }
+                }
+            }
+            if (options.is_holistic)
+            {
+                if (holistic_error != record.golden_holistic_error)
+                {
+                    differences.push_back("holistic_error: \"" + record.golden_holistic_error + "\" != \"" + holistic_error + "\"");
+                }
+                else if (holistic_error.empty() && !(std::abs(holistic_score - record.golden_holistic_score) <= options.epsilon))
+                {
+                    differences.push_back("holistic_score: " + std::to_string(record.golden_holistic_score) + " != " + std::to_string(holistic_score));
+                }
+            }
+            ++stats.compared_count;
+            if (!differences.empty())
+            {
+                ++stats.mismatch_count;
+                report_differences(options, index, differences);
+            }
+        }
+
+        if (golden_writer != nullptr)
+        {
+            record.has_golden = true;
+            record.golden_detail = detail;
+            record.golden_red_index_array = red_index_array;
+            record.golden_holistic_score = holistic_score;
+            record.golden_detail_error = detail_error;
+            record.golden_holistic_error = holistic_error;
+            golden_writer->write(index, record);
+        }
+    }
+}
+
+void print_histogram(const char *name, const HistogramSnapshot &snapshot)
+{
+    std::printf(
+        ",\"%s\":{\"count\":%llu,\"mean_ns\":%.0f,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}",
+        name, (unsigned long long)snapshot.total_count, snapshot.mean(),
+        (unsigned long long)snapshot.percentile(0.5),
+        (unsigned long long)snapshot.percentile(0.9),
+        (unsigned long long)snapshot.percentile(0.99),
+        (unsigned long long)snapshot.percentile(0.999),
+        (unsigned long long)snapshot.max);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <corpus.jsonl> [--threads N] [--config config_file] [--mode detail|holistic|both] [--epsilon e] [--write-golden out.jsonl] [--max-report N] [--trace trace.json]\n", argv[0]);
+        return 1;
+    }
+    ReplayOptions options;
+    options.corpus_path = argv[1];
+    for (auto i = 2; i + 1 < argc; i += 2)
+    {
+        std::string name = argv[i];
+        std::string value = argv[i + 1];
+        if (name == "--threads")
+        {
+            options.thread_count = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (name == "--config")
+        {
+            std::ifstream config_file(value);
+            std::stringstream config_stream;
+            config_stream << config_file.rdbuf();
+            options.config_line = config_stream.str();
+        }
+        else if (name == "--mode")
+        {
+            options.is_detail = value != "holistic";
+            options.is_holistic = value != "detail";
+        }
+        else if (name == "--epsilon")
+        {
+            options.epsilon = std::atof(value.c_str());
+        }
+        else if (name == "--write-golden")
+        {
+            options.golden_path = value;
+        }
+        else if (name == "--max-report")
+        {
+            options.max_report = std::atoi(value.c_str());
+        }
+        else if (name == "--trace")
+        {
+            options.trace_path = value;
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", name.c_str());
+            return 1;
+        }
+    }
+
+    CorpusReader reader(options.corpus_path);
+    std::unique_ptr<GoldenWriter> golden_writer;
+    if (!options.golden_path.empty())
+    {
+        golden_writer = std::make_unique<GoldenWriter>(options.golden_path, options.config_line.empty());
+    }
+    Tracer::instance().set_enabled(!options.trace_path.empty());
+    std::vector<ReplayWorkerStats> stats(options.thread_count);
+    std::vector<std::thread> threads;
+    auto begin = std::chrono::steady_clock::now();
+    for (auto i = 0; i < options.thread_count; ++i)
+    {
+        threads.emplace_back([&, i]()
+                             { replay_worker(options, reader, golden_writer.get(), stats[i]); });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    golden_writer.reset();
+    if (!options.trace_path.empty())
+    {
+        Tracer::instance().set_enabled(false);
+        Tracer::instance().write_chrome_trace(options.trace_path);
+    }
+
+    HistogramSnapshot detail_snapshot;
+    HistogramSnapshot holistic_snapshot;
+    ReplayWorkerStats total;
+    for (auto &item : stats)
+    {
+        detail_snapshot.merge(*item.detail_histogram);
+        holistic_snapshot.merge(*item.holistic_histogram);
+        total.record_count += item.record_count;
+        total.compared_count += item.compared_count;
+        total.mismatch_count += item.mismatch_count;
+        total.error_count += item.error_count;
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::printf(
+        "{\"records\":%d,\"threads\":%d,\"seconds\":%.3f,\"records_per_second\":%.1f,\"peak_rss_kb\":%ld,"
+        "\"errors\":%d,\"compared\":%d,\"mismatches\":%d",
+        total.record_count, options.thread_count, seconds, seconds > 0 ? total.record_count / seconds : 0.0,
+        usage.ru_maxrss, total.error_count, total.compared_count, total.mismatch_count);
+    if (options.is_detail)
+    {
+        print_histogram("score", detail_snapshot);
+    }
+    if (options.is_holistic)
+    {
+        print_histogram("score_holistic", holistic_snapshot);
+    }
+    std::printf("}\n");
+    return total.mismatch_count == 0 ? 0 : 2;
+}
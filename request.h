@@ -0,0 +1,130 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+#include <string>
+#include <vector>
+#include "configor/json.hpp"
+#include "info.h"
+
+//一次评测请求的全部输入,与Manager::score的参数一一对应
+class ScoreRequest
+{
+public:
+    std::vector<std::string> standard_lines;
+    std::vector<std::string> evaluate_lines;
+    CharacterInfo char_info;
+    std::vector<StructionInfo> struction_info_array;
+    std::vector<StrokeInfo> stroke_info_array;
+    std::string config_line;
+    bool is_character_right = true;
+};
+
+/**
+ * @brief 部件stroke_index_array中各序号对应的标准字笔画序号
+ *
+ * 部件的stroke_index_array是未跳过笔画中的序号,与Manager::get_stroke_map一致;
+ * stroke_info_array为空时按标准字的stroke_count笔依次对应
+ */
+inline std::vector<int> get_struction_stroke_orders(const std::vector<StrokeInfo> &stroke_info_array, int stroke_count)
+{
+    std::vector<int> orders;
+    if (stroke_info_array.empty())
+    {
+        for (auto i = 0; i < stroke_count; ++i)
+        {
+            orders.push_back(i);
+        }
+        return orders;
+    }
+    for (auto &stroke_info : stroke_info_array)
+    {
+        if (!stroke_info.is_skip)
+        {
+            orders.push_back(stroke_info.order);
+        }
+    }
+    return orders;
+}
+
+/**
+ * @brief 笔画映射改变后,把部件的stroke_index_array换算到新stroke_info_array中未跳过笔画的序号
+ *
+ * @param previous_orders 换算前部件序号对应的标准字笔画序号,由get_struction_stroke_orders求得
+ * 新映射中跳过的笔画从部件中去掉,去掉后没有笔画的部件从char_info.struction_index_array中去掉
+ */
+inline void remap_struction_strokes(
+    std::vector<StructionInfo> &struction_info_array,
+    CharacterInfo &char_info,
+    const std::vector<int> &previous_orders,
+    const std::vector<StrokeInfo> &stroke_info_array)
+{
+    std::vector<int> order_to_index;
+    auto index = 0;
+    for (auto &stroke_info : stroke_info_array)
+    {
+        if (stroke_info.is_skip || stroke_info.order < 0)
+        {
+            continue;
+        }
+        if (stroke_info.order >= order_to_index.size())
+        {
+            order_to_index.resize(stroke_info.order + 1, -1);
+        }
+        order_to_index[stroke_info.order] = index++;
+    }
+    for (auto &struction_info : struction_info_array)
+    {
+        std::vector<int> stroke_index_array;
+        for (auto i : struction_info.stroke_index_array)
+        {
+            if (i < 0 || i >= previous_orders.size())
+            {
+                continue;
+            }
+            auto order = previous_orders[i];
+            if (order >= 0 && order < order_to_index.size() && order_to_index[order] != -1)
+            {
+                stroke_index_array.push_back(order_to_index[order]);
+            }
+        }
+        struction_info.stroke_index_array = stroke_index_array;
+    }
+    std::vector<int> struction_index_array;
+    for (auto struction_index : char_info.struction_index_array)
+    {
+        if (struction_index >= 0 && struction_index < struction_info_array.size() &&
+            !struction_info_array[struction_index].stroke_index_array.empty())
+        {
+            struction_index_array.push_back(struction_index);
+        }
+    }
+    char_info.struction_index_array = struction_index_array;
+}
+
+//本次评测参与评分的层级,由Manager::get_score_plan在读取笔画段之前确定
+class ScorePlan
+{
+public:
+    bool is_stroke_level = true;    //笔画扣分
+    bool is_struction_level = true; //部件扣分
+    bool is_character_level = true; //整字扣分
+    bool is_only_character_right_and_speed = false; //基础分只保留错字与书写速度
+};
+
+//Manager::evaluate需要计算的结果
+enum EvaluateFlag
+{
+    EVALUATE_DETAIL = 1,   //详细评测结果,与score(...)返回的json和红色笔画下标一致
+    EVALUATE_HOLISTIC = 2, //整体评分,与double score(...)一致
+};
+
+class EvaluateResult
+{
+public:
+    bool has_detail = false;
+    configor::json detail;
+    std::vector<int> red_index_array;
+    bool has_holistic = false;
+    double holistic_score = 0.0;
+    bool is_degraded = false; //超过截止时间或被取消,detail为降级结果
+};
+#endif
@@ -0,0 +1,201 @@
+#ifndef REQUEST_HASH_H
+#define REQUEST_HASH_H
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+//128位哈希值
+class RequestHash
+{
+public:
+    std::uint64_t low = 0;
+    std::uint64_t high = 0;
+
+    bool operator==(const RequestHash &other) const
+    {
+        return low == other.low && high == other.high;
+    }
+    bool operator!=(const RequestHash &other) const
+    {
+        return !(*this == other);
+    }
+    std::string to_string() const
+    {
+        char text[33];
+        std::snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)high, (unsigned long long)low);
+        return text;
+    }
+};
+
+//本进程的SipHash密钥,首次使用时由std::random_device生成,进程内不变
+class HashKey
+{
+public:
+    std::uint64_t k0 = 0;
+    std::uint64_t k1 = 0;
+
+    static const HashKey &get_process_key()
+    {
+        static const HashKey key = make_random();
+        return key;
+    }
+    static HashKey make_random()
+    {
+        std::random_device device;
+        HashKey key;
+        key.k0 = ((std::uint64_t)device() << 32) | device();
+        key.k1 = ((std::uint64_t)device() << 32) | device();
+        return key;
+    }
+};
+
+/**
+ * @brief 可分段输入的128位带密钥哈希,算法为SipHash-2-4的128位输出版本
+ *
+ * 默认使用本进程的随机密钥,客户端不知道密钥,不能构造与其他请求哈希相同的请求来污染结果缓存;
+ * 分段输入与一次输入全部字节的结果相同,不同进程的哈希值不同,不可持久化
+ */
+class Hash128
+{
+public:
+    Hash128(const HashKey &key = HashKey::get_process_key())
+    {
+        m_v0 = key.k0 ^ 0x736f6d6570736575ull;
+        m_v1 = key.k1 ^ 0x646f72616e646f6dull ^ 0xee;
+        m_v2 = key.k0 ^ 0x6c7967656e657261ull;
+        m_v3 = key.k1 ^ 0x7465646279746573ull;
+    }
+    void update(const void *data, std::size_t size)
+    {
+        auto bytes = (const unsigned char *)data;
+        m_length += size;
+        if (m_buffer_size > 0)
+        {
+            auto count = std::min(size, (std::size_t)8 - m_buffer_size);
+            std::memcpy(m_buffer + m_buffer_size, bytes, count);
+            m_buffer_size += count;
+            bytes += count;
+            size -= count;
+            if (m_buffer_size < 8)
+            {
+                return;
+            }
+            process_block(load_u64(m_buffer));
+            m_buffer_size = 0;
+        }
+        while (size >= 8)
+        {
+            process_block(load_u64(bytes));
+            bytes += 8;
+            size -= 8;
+        }
+        std::memcpy(m_buffer, bytes, size);
+        m_buffer_size = size;
+    }
+    RequestHash finish() const
+    {
+        auto copy = *this;
+        std::uint64_t last = (std::uint64_t)(m_length & 0xff) << 56;
+        for (auto i = 0; i < m_buffer_size; ++i)
+        {
+            last |= (std::uint64_t)m_buffer[i] << (8 * i);
+        }
+        copy.process_block(last);
+        copy.m_v2 ^= 0xee;
+        for (auto i = 0; i < 4; ++i)
+        {
+            copy.round();
+        }
+        RequestHash hash;
+        hash.low = copy.m_v0 ^ copy.m_v1 ^ copy.m_v2 ^ copy.m_v3;
+        copy.m_v1 ^= 0xdd;
+        for (auto i = 0; i < 4; ++i)
+        {
+            copy.round();
+        }
+        hash.high = copy.m_v0 ^ copy.m_v1 ^ copy.m_v2 ^ copy.m_v3;
+        return hash;
+    }
+
+protected:
+    static std::uint64_t rotl(std::uint64_t value, int count)
+    {
+        return (value << count) | (value >> (64 - count));
+    }
+    static std::uint64_t load_u64(const unsigned char *bytes)
+    {
+        std::uint64_t value = 0;
+        for (auto i = 0; i < 8; ++i)
+        {
+            value |= (std::uint64_t)bytes[i] << (8 * i);
+        }
+        return value;
+    }
+    void round()
+    {
+        m_v0 += m_v1;
+        m_v1 = rotl(m_v1, 13);
+        m_v1 ^= m_v0;
+        m_v0 = rotl(m_v0, 32);
+        m_v2 += m_v3;
+        m_v3 = rotl(m_v3, 16);
+        m_v3 ^= m_v2;
+        m_v0 += m_v3;
+        m_v3 = rotl(m_v3, 21);
+        m_v3 ^= m_v0;
+        m_v2 += m_v1;
+        m_v1 = rotl(m_v1, 17);
+        m_v1 ^= m_v2;
+        m_v2 = rotl(m_v2, 32);
+    }
+    void process_block(std::uint64_t block)
+    {
+        m_v3 ^= block;
+        round();
+        round();
+        m_v0 ^= block;
+    }
+    std::uint64_t m_v0;
+    std::uint64_t m_v1;
+    std::uint64_t m_v2;
+    std::uint64_t m_v3;
+    unsigned char m_buffer[8];
+    std::size_t m_buffer_size = 0;
+    std::uint64_t m_length = 0;
+};
+
+//以写入二进制布局的方式计算哈希,与对同一布局的字节直接计算哈希结果相同
+class HashWriter
+{
+public:
+    Hash128 hash;
+    void write_u32(std::uint32_t value)
+    {
+        unsigned char bytes[4];
+        for (auto i = 0; i < 4; ++i)
+        {
+            bytes[i] = (unsigned char)(value >> (8 * i));
+        }
+        hash.update(bytes, 4);
+    }
+    void write_f64(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, 8);
+        unsigned char bytes[8];
+        for (auto i = 0; i < 8; ++i)
+        {
+            bytes[i] = (unsigned char)(bits >> (8 * i));
+        }
+        hash.update(bytes, 8);
+    }
+    void write_string(const std::string &value)
+    {
+        write_u32((std::uint32_t)value.size());
+        hash.update(value.data(), value.size());
+    }
+};
+#endif
@@ -0,0 +1,186 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+#include <cmath>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+//笔画段点的重采样方式
+enum class ResampleMode
+{
+    none,            //保留全部采样点
+    duplicate,       //只去掉相邻重复点
+    arc_length,      //按弧长等距重采样,tolerance为间距
+    douglas_peucker, // Douglas-Peucker折线简化,tolerance为最大偏离距离
+};
+
+class ResampleOptions
+{
+public:
+    ResampleMode mode = ResampleMode::none;
+    double tolerance = 1.0; //画布像素
+    bool operator==(const ResampleOptions &other) const
+    {
+        return mode == other.mode && tolerance == other.tolerance;
+    }
+    bool operator!=(const ResampleOptions &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+//笔画段重采样前后的点数
+class SegmentPointCount
+{
+public:
+    int index;
+    int raw_count;
+    int resampled_count;
+};
+
+//重采样在语料上的验证结果
+class ResampleValidationReport
+{
+public:
+    int request_count = 0;
+    int raw_point_count = 0;       //重采样前的总点数
+    int resampled_point_count = 0; //重采样后的总点数
+    double max_score_diff = 0.0;    //详细评测score字段的最大差
+    double max_holistic_diff = 0.0; //整体评分的最大差
+    std::vector<int> failed_index_array; //超出epsilon的请求下标
+    bool is_passed = true;
+};
+
+inline std::vector<cv::Point2i> remove_duplicate_points(const std::vector<cv::Point2i> &points)
+{
+    std::vector<cv::Point2i> result;
+    result.reserve(points.size());
+    for (auto &point : points)
+    {
+        if (result.empty() || result.back() != point)
+        {
+            result.push_back(point);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief 按弧长等距重采样,首尾点保留
+ *
+ * @param step 相邻采样点的弧长间距
+ */
+inline std::vector<cv::Point2i> resample_by_arc_length(const std::vector<cv::Point2i> &points, double step)
+{
+    auto unique_points = remove_duplicate_points(points);
+    if (unique_points.size() <= 2 || step <= 0)
+    {
+        return unique_points;
+    }
+    std::vector<cv::Point2i> result{unique_points.front()};
+    auto distance_to_next = step; //距下一个采样点的剩余弧长
+    for (auto i = 1; i < unique_points.size(); ++i)
+    {
+        double x0 = unique_points[i - 1].x;
+        double y0 = unique_points[i - 1].y;
+        double dx = unique_points[i].x - x0;
+        double dy = unique_points[i].y - y0;
+        auto length = std::sqrt(dx * dx + dy * dy);
+        auto position = distance_to_next;
+        while (position <= length)
+        {
+            auto t = position / length;
+            cv::Point2i point((int)std::lround(x0 + dx * t), (int)std::lround(y0 + dy * t));
+            if (result.back() != point)
+            {
+                result.push_back(point);
+            }
+            position += step;
+        }
+        distance_to_next = position - length;
+    }
+    if (result.back() != unique_points.back())
+    {
+        result.push_back(unique_points.back());
+    }
+    return result;
+}
+
+/**
+ * @brief Douglas-Peucker折线简化,用栈代替递归
+ *
+ * @param tolerance 被删除的点到保留折线的最大距离
+ */
+inline std::vector<cv::Point2i> douglas_peucker(const std::vector<cv::Point2i> &points, double tolerance)
+{
+    auto unique_points = remove_duplicate_points(points);
+    if (unique_points.size() <= 2 || tolerance <= 0)
+    {
+        return unique_points;
+    }
+    std::vector<bool> is_kept(unique_points.size(), false);
+    is_kept.front() = true;
+    is_kept.back() = true;
+    std::vector<std::pair<int, int>> ranges{{0, (int)unique_points.size() - 1}};
+    auto tolerance_squared = tolerance * tolerance;
+    while (!ranges.empty())
+    {
+        auto [first, last] = ranges.back();
+        ranges.pop_back();
+        double dx = unique_points[last].x - unique_points[first].x;
+        double dy = unique_points[last].y - unique_points[first].y;
+        auto length_squared = dx * dx + dy * dy;
+        auto max_distance_squared = -1.0;
+        auto max_index = -1;
+        for (auto i = first + 1; i < last; ++i)
+        {
+            double px = unique_points[i].x - unique_points[first].x;
+            double py = unique_points[i].y - unique_points[first].y;
+            double distance_squared;
+            if (length_squared == 0)
+            {
+                distance_squared = px * px + py * py;
+            }
+            else
+            {
+                auto cross = px * dy - py * dx;
+                distance_squared = cross * cross / length_squared;
+            }
+            if (distance_squared > max_distance_squared)
+            {
+                max_distance_squared = distance_squared;
+                max_index = i;
+            }
+        }
+        if (max_index != -1 && max_distance_squared > tolerance_squared)
+        {
+            is_kept[max_index] = true;
+            ranges.push_back({first, max_index});
+            ranges.push_back({max_index, last});
+        }
+    }
+    std::vector<cv::Point2i> result;
+    for (auto i = 0; i < unique_points.size(); ++i)
+    {
+        if (is_kept[i])
+        {
+            result.push_back(unique_points[i]);
+        }
+    }
+    return result;
+}
+
+inline std::vector<cv::Point2i> resample_points(const std::vector<cv::Point2i> &points, ResampleOptions options)
+{
+    switch (options.mode)
+    {
+    case ResampleMode::duplicate:
+        return remove_duplicate_points(points);
+    case ResampleMode::arc_length:
+        return resample_by_arc_length(points, options.tolerance);
+    case ResampleMode::douglas_peucker:
+        return douglas_peucker(points, options.tolerance);
+    default:
+        return points;
+    }
+}
+#endif
@@ -0,0 +1,205 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "configor/json.hpp"
+#include "protocol.h"
+#include "request_hash.h"
+
+//缓存的评测结果:详细评测json序列化后的字节与红色笔画下标、整体评分,以及二进制响应用的CompactResult
+class CachedResult
+{
+public:
+    bool has_detail = false;
+    std::string detail_bytes;
+    std::vector<int> red_index_array;
+    bool has_holistic = false;
+    double holistic_score = 0.0;
+    CompactResult compact;
+
+    static std::shared_ptr<const CachedResult> from_evaluate_result(const EvaluateResult &result)
+    {
+        auto cached = std::make_shared<CachedResult>();
+        cached->has_detail = result.has_detail;
+        if (result.has_detail)
+        {
+            cached->detail_bytes = result.detail.dump();
+        }
+        cached->red_index_array = result.red_index_array;
+        cached->has_holistic = result.has_holistic;
+        cached->holistic_score = result.holistic_score;
+        cached->compact = CompactResult::from_evaluate_result(0, result);
+        return cached;
+    }
+    std::size_t get_byte_size() const
+    {
+        return detail_bytes.size() + red_index_array.size() * sizeof(int) + compact.numbers.size() * sizeof(double);
+    }
+};
+
+//与dump_score_response的响应等价,详细评测直接拼接缓存的json字节,不再序列化
+inline std::string dump_cached_response(std::uint32_t id, ResultFormat format, const CachedResult &cached)
+{
+    if (format == ResultFormat::binary)
+    {
+        auto compact = cached.compact;
+        compact.id = id;
+        BinaryWriter writer;
+        writer.data.push_back('B');
+        write_compact_result(writer, compact);
+        return writer.data;
+    }
+    configor::json res;
+    res["id"] = (long long)id;
+    res["error"] = "";
+    if (cached.has_detail)
+    {
+        res["red_index_array"] = cached.red_index_array;
+    }
+    if (cached.has_holistic)
+    {
+        res["holistic_score"] = cached.holistic_score;
+    }
+    auto text = res.dump();
+    if (!cached.has_detail)
+    {
+        return "J" + text;
+    }
+    return "J{\"detail\":" + cached.detail_bytes + "," + text.substr(1);
+}
+
+class ResultCacheOptions
+{
+public:
+    std::size_t capacity = 4096;              //最多缓存的结果数,平均分到各分片
+    int shard_count = 16;                     //分片数,各分片一把锁
+    std::size_t max_entry_bytes = 256 * 1024; //超过该大小的结果不缓存
+};
+
+/**
+ * @brief 有界的分片结果缓存,以请求的规范哈希与flags为键,多线程共用
+ *
+ * 每个分片为一个LRU链表,分片满时淘汰最久未用的结果;哈希的高64位选分片
+ * 哈希带本进程的随机密钥,客户端无法构造与其他请求相同的键而取得或污染他人的结果
+ * 只缓存评测成功的结果,重复的请求(网络重试、反复评测的测试用例)不再评测
+ */
+class ResultCache
+{
+public:
+    ResultCache(ResultCacheOptions options = ResultCacheOptions()) : m_options(options)
+    {
+        auto shard_count = std::max(1, m_options.shard_count);
+        for (auto i = 0; i < shard_count; ++i)
+        {
+            m_shards.push_back(std::make_unique<Shard>());
+        }
+        m_shard_capacity = std::max((std::size_t)1, m_options.capacity / shard_count);
+    }
+    //不存在时返回nullptr
+    std::shared_ptr<const CachedResult> find(const RequestHash &hash, int flags)
+    {
+        auto &shard = get_shard(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto iter = shard.index.find({hash, flags});
+        if (iter == shard.index.end())
+        {
+            ++m_miss_count;
+            return nullptr;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+        ++m_hit_count;
+        return iter->second->second;
+    }
+    void insert(const RequestHash &hash, int flags, std::shared_ptr<const CachedResult> result)
+    {
+        if (result->get_byte_size() > m_options.max_entry_bytes)
+        {
+            return;
+        }
+        auto &shard = get_shard(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Key key{hash, flags};
+        auto iter = shard.index.find(key);
+        if (iter != shard.index.end())
+        {
+            iter->second->second = result;
+            shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+            return;
+        }
+        shard.entries.emplace_front(key, result);
+        shard.index[key] = shard.entries.begin();
+        ++m_insert_count;
+        if (shard.entries.size() > m_shard_capacity)
+        {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+            ++m_evict_count;
+        }
+    }
+    std::size_t size()
+    {
+        std::size_t count = 0;
+        for (auto &shard : m_shards)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            count += shard->entries.size();
+        }
+        return count;
+    }
+    configor::json to_json()
+    {
+        configor::json res;
+        res["size"] = (long long)size();
+        res["hit_count"] = (long long)m_hit_count.load();
+        res["miss_count"] = (long long)m_miss_count.load();
+        res["insert_count"] = (long long)m_insert_count.load();
+        res["evict_count"] = (long long)m_evict_count.load();
+        return res;
+    }
+
+protected:
+    class Key
+    {
+    public:
+        RequestHash hash;
+        int flags;
+        bool operator==(const Key &other) const
+        {
+            return hash == other.hash && flags == other.flags;
+        }
+    };
+    class KeyHasher
+    {
+    public:
+        std::size_t operator()(const Key &key) const
+        {
+            return (std::size_t)(key.hash.low ^ ((std::uint64_t)key.flags * 0x9e3779b97f4a7c15ull));
+        }
+    };
+    class Shard
+    {
+    public:
+        std::mutex mutex;
+        std::list<std::pair<Key, std::shared_ptr<const CachedResult>>> entries; //表头为最近使用
+        std::unordered_map<Key, std::list<std::pair<Key, std::shared_ptr<const CachedResult>>>::iterator, KeyHasher> index;
+    };
+    Shard &get_shard(const RequestHash &hash)
+    {
+        return *m_shards[hash.high % m_shards.size()];
+    }
+    ResultCacheOptions m_options;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::size_t m_shard_capacity;
+    std::atomic<std::uint64_t> m_hit_count{0};
+    std::atomic<std::uint64_t> m_miss_count{0};
+    std::atomic<std::uint64_t> m_insert_count{0};
+    std::atomic<std::uint64_t> m_evict_count{0};
+};
+#endif
@@ -0,0 +1,209 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "manager.h"
+#include "protocol.h"
+#include "result_cache.h"
+
+//参考字与配置相同的请求可以合批,合批后只解析一次配置、读取一次标准字
+inline std::uint64_t get_reference_key(const ScoreRequest &request)
+{
+    std::hash<std::string> hash;
+    std::uint64_t key = hash(request.config_line);
+    for (auto &line : request.standard_lines)
+    {
+        key = key * 1099511628211ull ^ hash(line);
+    }
+    return key;
+}
+
+//一个待评测的请求,reply在评测线程中调用,由连接或通道按各自的方式写出响应
+class ScoreJob
+{
+public:
+    ScoreEnvelope envelope;
+    std::uint64_t reference_key = 0;
+    std::function<void(const EvaluateResult &result, const std::string &error)> reply;
+    std::shared_ptr<CancellationToken> token; //不为空时评测超时返回降级结果,截止时间含排队时间
+};
+
+class BatchQueueOptions
+{
+public:
+    std::size_t capacity = 1024;      //队列满时push阻塞或拒绝
+    std::size_t max_batch_size = 16;  //一批最多的请求数
+    int batch_wait_us = 200;          //一批未满时等待同参考字请求的最长时间
+};
+
+/**
+ * @brief 有界的请求队列,按参考字取出一批
+ *
+ * 取出时以队首请求的参考字为准,从队列中挑出同参考字的请求,其余请求保持原顺序
+ * 队列满时读取线程阻塞,不再从连接读取,客户端写入随之阻塞,形成背压
+ */
+class BatchQueue
+{
+public:
+    BatchQueue(BatchQueueOptions options = BatchQueueOptions()) : m_options(options)
+    {
+    }
+    //is_blocking为false且队列已满时返回false;队列关闭后返回false
+    bool push(ScoreJob job, bool is_blocking = true)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (is_blocking)
+        {
+            m_not_full.wait(lock, [&]()
+                            { return m_is_closed || m_jobs.size() < m_options.capacity; });
+        }
+        if (m_is_closed || m_jobs.size() >= m_options.capacity)
+        {
+            return false;
+        }
+        m_jobs.push_back(std::move(job));
+        m_not_empty.notify_all();
+        return true;
+    }
+    //队列关闭且为空时返回false
+    bool pop_batch(std::vector<ScoreJob> &batch)
+    {
+        batch.clear();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [&]()
+                         { return m_is_closed || !m_jobs.empty(); });
+        if (m_jobs.empty())
+        {
+            return false;
+        }
+        auto reference_key = m_jobs.front().reference_key;
+        take_jobs(reference_key, batch);
+        if (batch.size() < m_options.max_batch_size && m_options.batch_wait_us > 0 && !m_is_closed)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(m_options.batch_wait_us);
+            while (batch.size() < m_options.max_batch_size && !m_is_closed &&
+                   m_not_empty.wait_until(lock, deadline) != std::cv_status::timeout)
+            {
+                take_jobs(reference_key, batch);
+            }
+            take_jobs(reference_key, batch);
+        }
+        m_not_full.notify_all();
+        return true;
+    }
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_closed = true;
+        m_not_empty.notify_all();
+        m_not_full.notify_all();
+    }
+    std::size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_jobs.size();
+    }
+
+protected:
+    void take_jobs(std::uint64_t reference_key, std::vector<ScoreJob> &batch)
+    {
+        for (auto iter = m_jobs.begin(); iter != m_jobs.end() && batch.size() < m_options.max_batch_size;)
+        {
+            if (iter->reference_key == reference_key)
+            {
+                batch.push_back(std::move(*iter));
+                iter = m_jobs.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+    BatchQueueOptions m_options;
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::list<ScoreJob> m_jobs;
+    bool m_is_closed = false;
+};
+
+class ScoringServerStats
+{
+public:
+    std::atomic<std::uint64_t> request_count{0};
+    std::atomic<std::uint64_t> batch_count{0};
+    std::atomic<std::uint64_t> error_count{0};    //评测抛出异常的请求
+    std::atomic<std::uint64_t> rejected_count{0}; //队列满被拒绝或无法解析的请求
+    std::atomic<std::uint64_t> dropped_count{0};  //前端长时间不读取,响应环写满而丢弃的响应
+    std::atomic<std::uint64_t> degraded_count{0}; //超过截止时间返回降级结果的请求
+
+    configor::json to_json() const
+    {
+        configor::json res;
+        res["request_count"] = (long long)request_count.load();
+        res["batch_count"] = (long long)batch_count.load();
+        res["mean_batch_size"] = batch_count == 0 ? 0.0 : (double)request_count / batch_count;
+        res["error_count"] = (long long)error_count.load();
+        res["rejected_count"] = (long long)rejected_count.load();
+        res["dropped_count"] = (long long)dropped_count.load();
+        res["degraded_count"] = (long long)degraded_count.load();
+        return res;
+    }
+};
+
+/**
+ * @brief 评测线程:每个线程一个Manager,开启参考字缓存,逐批评测并回复,队列关闭后返回
+ *
+ * @param setup 在开始评测前设置Manager,例如开启画布复用
+ * @param result_cache 不为空时评测成功的结果以请求哈希存入,重复的请求由读取线程直接回复
+ */
+inline void run_scoring_worker(BatchQueue &queue, ScoringServerStats &stats, const std::function<void(Manager &)> &setup = nullptr, ResultCache *result_cache = nullptr)
+{
+    Manager manager{Config()};
+    manager.init();
+    manager.set_reference_cache(true);
+    if (setup)
+    {
+        setup(manager);
+    }
+    std::vector<ScoreJob> batch;
+    while (queue.pop_batch(batch))
+    {
+        ++stats.batch_count;
+        for (auto &job : batch)
+        {
+            EvaluateResult result;
+            std::string error;
+            manager.set_cancellation_token(job.token);
+            try
+            {
+                result = manager.evaluate(job.envelope.request, job.envelope.flags);
+                if (result.is_degraded)
+                {
+                    ++stats.degraded_count;
+                }
+                else if (result_cache != nullptr)
+                {
+                    result_cache->insert(job.envelope.request_hash, job.envelope.flags, CachedResult::from_evaluate_result(result));
+                }
+            }
+            catch (const std::exception &e)
+            {
+                error = e.what();
+                ++stats.error_count;
+            }
+            manager.set_cancellation_token(nullptr);
+            ++stats.request_count;
+            job.reply(result, error);
+        }
+    }
+}
+#endif
@@ -0,0 +1,429 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "protocol.h"
+
+/**
+ * 同机前端与评测服务之间的共享内存通道
+ *
+ * 一个通道为一段POSIX共享内存,内含请求环与响应环,各为单生产者单消费者的无锁字节环
+ * 前端直接把请求的二进制布局(write_score_envelope)写入请求环,评测服务在环内原地解析
+ * 响应负载与套接字相同('B'加CompactResult或'J'加json),二进制格式时直接写入响应环
+ * 一个通道只供一个前端进程使用,多个前端使用多个通道
+ */
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared memory ring needs lock-free 64-bit atomics");
+
+constexpr std::uint32_t SHM_CHANNEL_MAGIC = 0x52534843; //"CHSR"
+constexpr std::uint32_t SHM_CHANNEL_VERSION = 2;
+
+//等待对端时先空转,再让出时间片,最后短暂休眠,空闲时不占满CPU
+class ShmBackoff
+{
+public:
+    void wait()
+    {
+        if (m_count < 128)
+        {
+        }
+        else if (m_count < 1024)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+        ++m_count;
+    }
+    void reset()
+    {
+        m_count = 0;
+    }
+
+protected:
+    int m_count = 0;
+};
+
+//环的读写位置,head与tail分属不同缓存行,避免生产者与消费者互相失效
+class ShmRingHeader
+{
+public:
+    alignas(64) std::atomic<std::uint64_t> head; //已提交的写入位置,只由生产者修改
+    alignas(64) std::atomic<std::uint64_t> tail; //已释放的读取位置,只由消费者修改
+};
+
+/**
+ * @brief 共享内存中的单生产者单消费者字节环
+ *
+ * 每条记录为u32长度、u32保留与负载,按8字节对齐;环尾放不下时写入回绕标记,从环首继续
+ * 生产者reserve得到环内的写入地址,写完后commit;消费者peek得到环内的负载地址,用完后release
+ * 读写位置单调增加,与capacity - 1按位与得到偏移,capacity为2的幂
+ */
+class ShmRing
+{
+public:
+    static constexpr std::uint32_t WRAP_MARKER = 0xFFFFFFFF;
+
+    ShmRing() = default;
+    ShmRing(ShmRingHeader *header, char *data, std::uint64_t capacity) : m_header(header), m_data(data), m_capacity(capacity)
+    {
+    }
+    //单条记录的最大负载,保证任何时刻都能放下一条记录
+    std::size_t get_max_record_size() const
+    {
+        return m_capacity / 2 - 8;
+    }
+
+    //预留size字节的负载空间,环满时等待,超时返回nullptr;size超过get_max_record_size时抛出异常
+    char *reserve(std::size_t size, std::chrono::steady_clock::time_point deadline)
+    {
+        if (size > get_max_record_size())
+        {
+            throw std::runtime_error("record too large for shared memory ring: " + std::to_string(size));
+        }
+        auto head = m_header->head.load(std::memory_order_relaxed);
+        auto offset = head & (m_capacity - 1);
+        auto need = get_record_size(size);
+        auto padding = offset + need > m_capacity ? m_capacity - offset : 0;
+        ShmBackoff backoff;
+        while (head + padding + need - m_header->tail.load(std::memory_order_acquire) > m_capacity)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return nullptr;
+            }
+            backoff.wait();
+        }
+        if (padding > 0)
+        {
+            write_u32(offset, WRAP_MARKER);
+            offset = 0;
+        }
+        m_reserved_position = head + padding;
+        m_reserved_size = size;
+        write_u32(offset, (std::uint32_t)size);
+        return m_data + offset + 8;
+    }
+    void commit()
+    {
+        m_header->head.store(m_reserved_position + get_record_size(m_reserved_size), std::memory_order_release);
+    }
+    bool write(const char *data, std::size_t size, std::chrono::steady_clock::time_point deadline)
+    {
+        auto buffer = reserve(size, deadline);
+        if (buffer == nullptr)
+        {
+            return false;
+        }
+        std::memcpy(buffer, data, size);
+        commit();
+        return true;
+    }
+
+    /**
+     * @brief 取出下一条记录的负载地址,环空时返回nullptr;地址在release之前有效
+     *
+     * 环内的长度与读写位置可被对端任意改写,长度超过get_max_record_size、超出已提交的数据
+     * 或越过环尾时抛出异常,记录未被取出,调用方应以drain丢弃整个环
+     */
+    const char *peek(std::size_t &size)
+    {
+        auto tail = m_header->tail.load(std::memory_order_relaxed);
+        auto head = m_header->head.load(std::memory_order_acquire);
+        if (tail == head)
+        {
+            return nullptr;
+        }
+        if (head - tail > m_capacity)
+        {
+            throw std::runtime_error("corrupt shared memory ring: " + std::to_string(head - tail) + " bytes committed");
+        }
+        auto offset = tail & (m_capacity - 1);
+        auto record_size = read_u32(offset);
+        if (record_size == WRAP_MARKER)
+        {
+            if (offset == 0 || head - tail <= m_capacity - offset)
+            {
+                throw std::runtime_error("corrupt shared memory ring: bad wrap marker");
+            }
+            tail += m_capacity - offset;
+            offset = 0;
+            record_size = read_u32(offset);
+        }
+        if (record_size > get_max_record_size() || get_record_size(record_size) > head - tail ||
+            offset + get_record_size(record_size) > m_capacity)
+        {
+            throw std::runtime_error("corrupt shared memory ring: record size " + std::to_string(record_size));
+        }
+        m_peeked_position = tail;
+        m_peeked_size = record_size;
+        size = record_size;
+        return m_data + offset + 8;
+    }
+    void release()
+    {
+        m_header->tail.store(m_peeked_position + get_record_size(m_peeked_size), std::memory_order_release);
+    }
+    //丢弃环中全部记录,只能由消费者调用
+    void drain()
+    {
+        m_header->tail.store(m_header->head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+protected:
+    static std::uint64_t get_record_size(std::size_t size)
+    {
+        return (8 + size + 7) & ~(std::uint64_t)7;
+    }
+    void write_u32(std::uint64_t offset, std::uint32_t value)
+    {
+        std::memcpy(m_data + offset, &value, 4);
+    }
+    std::uint32_t read_u32(std::uint64_t offset) const
+    {
+        std::uint32_t value;
+        std::memcpy(&value, m_data + offset, 4);
+        return value;
+    }
+    ShmRingHeader *m_header = nullptr;
+    char *m_data = nullptr;
+    std::uint64_t m_capacity = 0;
+    std::uint64_t m_reserved_position = 0;
+    std::size_t m_reserved_size = 0;
+    std::uint64_t m_peeked_position = 0;
+    std::size_t m_peeked_size = 0;
+};
+
+class ShmChannelHeader
+{
+public:
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t ring_capacity;
+    std::atomic<std::int64_t> client_pid; //正在使用通道的前端进程,0为空闲
+    std::atomic<std::uint32_t> claim_count; //前端占用通道的次数,用于区分各次占用的请求id
+};
+
+/**
+ * @brief 一个共享内存通道
+ *
+ * 布局:ShmChannelHeader(占64字节),请求环的ShmRingHeader与数据,响应环的ShmRingHeader与数据
+ * 评测服务以create创建并在析构时删除,前端以open打开并占用,析构时释放占用
+ */
+class ShmChannel
+{
+public:
+    ShmChannel(const ShmChannel &) = delete;
+    ShmChannel &operator=(const ShmChannel &) = delete;
+    ~ShmChannel()
+    {
+        if (m_header != nullptr && !m_is_owner)
+        {
+            m_header->client_pid.store(0);
+        }
+        if (m_base != nullptr)
+        {
+            ::munmap(m_base, m_size);
+        }
+        if (m_is_owner)
+        {
+            ::shm_unlink(m_name.c_str());
+        }
+    }
+
+    //name以/开头,ring_capacity为每个环的字节数,向上取为2的幂
+    static std::unique_ptr<ShmChannel> create(const std::string &name, std::uint64_t ring_capacity = 16 * 1024 * 1024)
+    {
+        std::uint64_t capacity = 4096;
+        while (capacity < ring_capacity)
+        {
+            capacity *= 2;
+        }
+        std::unique_ptr<ShmChannel> channel(new ShmChannel(name, true));
+        ::shm_unlink(name.c_str());
+        auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot create shared memory " + name + ": " + std::strerror(errno));
+        }
+        channel->m_size = get_channel_size(capacity);
+        auto is_mapped = ::ftruncate(fd, (off_t)channel->m_size) == 0 && channel->map(fd);
+        ::close(fd);
+        if (!is_mapped)
+        {
+            throw std::runtime_error("cannot map shared memory " + name + ": " + std::strerror(errno));
+        }
+        auto header = new (channel->m_base) ShmChannelHeader();
+        header->magic = SHM_CHANNEL_MAGIC;
+        header->version = SHM_CHANNEL_VERSION;
+        header->ring_capacity = capacity;
+        header->client_pid.store(0);
+        header->claim_count.store(0);
+        for (auto i = 0; i < 2; ++i)
+        {
+            auto ring_header = new (channel->m_base + get_ring_offset(capacity, i)) ShmRingHeader();
+            ring_header->head.store(0);
+            ring_header->tail.store(0);
+        }
+        channel->attach(header);
+        return channel;
+    }
+
+    //打开评测服务创建的通道并占用;通道已被存活的前端占用时抛出异常,占用者已退出时接管
+    static std::unique_ptr<ShmChannel> open(const std::string &name)
+    {
+        std::unique_ptr<ShmChannel> channel(new ShmChannel(name, false));
+        auto fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot open shared memory " + name + ": " + std::strerror(errno));
+        }
+        struct stat file_stat;
+        auto is_mapped = ::fstat(fd, &file_stat) == 0 && file_stat.st_size >= (off_t)sizeof(ShmChannelHeader);
+        if (is_mapped)
+        {
+            channel->m_size = (std::size_t)file_stat.st_size;
+            is_mapped = channel->map(fd);
+        }
+        ::close(fd);
+        if (!is_mapped)
+        {
+            throw std::runtime_error("cannot map shared memory " + name);
+        }
+        auto header = (ShmChannelHeader *)channel->m_base;
+        if (header->magic != SHM_CHANNEL_MAGIC || header->version != SHM_CHANNEL_VERSION ||
+            get_channel_size(header->ring_capacity) != channel->m_size)
+        {
+            throw std::runtime_error("not a scoring channel: " + name);
+        }
+        std::int64_t pid = header->client_pid.load();
+        std::int64_t self = ::getpid();
+        do
+        {
+            if (pid != 0 && ::kill((pid_t)pid, 0) == 0)
+            {
+                throw std::runtime_error("shared memory channel in use: " + name);
+            }
+        } while (!header->client_pid.compare_exchange_weak(pid, self));
+        channel->m_header = header;
+        channel->attach(header);
+        //上一个前端留下的响应属于已退出的进程;它留在请求环中的请求仍会被评测,
+        //本次占用的请求id从不同的起点开始,这些请求的响应按id丢弃
+        channel->m_response_ring.drain();
+        channel->m_claim_index = header->claim_count.fetch_add(1) + 1;
+        return channel;
+    }
+
+    ShmRing &get_request_ring()
+    {
+        return m_request_ring;
+    }
+    ShmRing &get_response_ring()
+    {
+        return m_response_ring;
+    }
+    const std::string &get_name() const
+    {
+        return m_name;
+    }
+    //本次占用的请求id起点,相邻各次占用的起点在u32范围内相距很远
+    std::uint32_t get_id_base() const
+    {
+        return m_claim_index * 0x9e3779b9u;
+    }
+
+protected:
+    ShmChannel(const std::string &name, bool is_owner) : m_name(name), m_is_owner(is_owner)
+    {
+    }
+    static std::uint64_t get_ring_offset(std::uint64_t capacity, int index)
+    {
+        return 64 + index * (sizeof(ShmRingHeader) + capacity);
+    }
+    static std::size_t get_channel_size(std::uint64_t capacity)
+    {
+        return (std::size_t)get_ring_offset(capacity, 2);
+    }
+    bool map(int fd)
+    {
+        auto base = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            return false;
+        }
+        m_base = (char *)base;
+        return true;
+    }
+    void attach(ShmChannelHeader *header)
+    {
+        auto capacity = header->ring_capacity;
+        for (auto i = 0; i < 2; ++i)
+        {
+            auto ring_header = (ShmRingHeader *)(m_base + get_ring_offset(capacity, i));
+            (i == 0 ? m_request_ring : m_response_ring) = ShmRing(ring_header, (char *)(ring_header + 1), capacity);
+        }
+    }
+    std::string m_name;
+    bool m_is_owner;
+    char *m_base = nullptr;
+    std::size_t m_size = 0;
+    ShmChannelHeader *m_header = nullptr; //前端占用的通道,析构时释放
+    std::uint32_t m_claim_index = 0;      //前端本次占用的序号
+    ShmRing m_request_ring;
+    ShmRing m_response_ring;
+};
+
+//把请求的二进制布局直接写入请求环,超时返回false
+inline bool write_shm_envelope(ShmRing &ring, const ScoreEnvelope &envelope, std::chrono::steady_clock::time_point deadline)
+{
+    BinarySizer sizer;
+    write_score_envelope(sizer, envelope);
+    auto buffer = ring.reserve(sizer.size, deadline);
+    if (buffer == nullptr)
+    {
+        return false;
+    }
+    BufferWriter writer(buffer);
+    write_score_envelope(writer, envelope);
+    ring.commit();
+    return true;
+}
+
+//写入响应,二进制格式时CompactResult直接写入响应环,超时返回false
+inline bool write_shm_response(ShmRing &ring, std::uint32_t id, ResultFormat format, const EvaluateResult &result, const std::string &error, std::chrono::steady_clock::time_point deadline)
+{
+    if (format != ResultFormat::binary)
+    {
+        auto payload = dump_score_response(id, format, result, error);
+        return ring.write(payload.data(), payload.size(), deadline);
+    }
+    auto compact = CompactResult::from_evaluate_result(id, result);
+    compact.error = error;
+    BinarySizer sizer;
+    write_compact_result(sizer, compact);
+    auto buffer = ring.reserve(1 + sizer.size, deadline);
+    if (buffer == nullptr)
+    {
+        return false;
+    }
+    buffer[0] = 'B';
+    BufferWriter writer(buffer + 1);
+    write_compact_result(writer, compact);
+    ring.commit();
+    return true;
+}
+#endif
@@ -0,0 +1,161 @@
+#ifndef SPEED_H
+#define SPEED_H
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "configor/json.hpp"
+
+class WritingSpeedOptions
+{
+public:
+    double pause_threshold_ms = 300.0; //笔画段内相邻两点间隔超过该值视为停顿
+};
+
+//一个笔画段的时间统计,长度以书写区域的宽高归一化
+class SegmentTiming
+{
+public:
+    int index = 0;
+    bool has_time = false;  //每个点都有时间戳
+    int point_count = 0;
+    double start_time = 0.0; //毫秒
+    double end_time = 0.0;
+    double length = 0.0;
+    double pause_time = 0.0; //段内停顿的总时长
+    int pause_count = 0;
+    double get_duration() const
+    {
+        return end_time - start_time;
+    }
+};
+
+/**
+ * @brief 读取笔画段时逐点累计时间统计,不另外解析
+ *
+ */
+class SegmentTimingBuilder
+{
+public:
+    SegmentTimingBuilder(int index, WritingSpeedOptions options = WritingSpeedOptions()) : m_options(options)
+    {
+        m_timing.index = index;
+        m_timing.has_time = true;
+    }
+    //没有时间戳的点
+    void add(double x, double y)
+    {
+        m_timing.has_time = false;
+        ++m_timing.point_count;
+    }
+    void add(double x, double y, double time)
+    {
+        if (m_timing.point_count == 0)
+        {
+            m_timing.start_time = time;
+        }
+        else
+        {
+            m_timing.length += std::sqrt((x - m_x) * (x - m_x) + (y - m_y) * (y - m_y));
+            auto gap = time - m_timing.end_time;
+            if (gap > m_options.pause_threshold_ms)
+            {
+                m_timing.pause_time += gap;
+                ++m_timing.pause_count;
+            }
+        }
+        m_timing.end_time = time;
+        m_x = x;
+        m_y = y;
+        ++m_timing.point_count;
+    }
+    SegmentTiming get() const
+    {
+        auto timing = m_timing;
+        timing.has_time = timing.has_time && timing.point_count > 0;
+        return timing;
+    }
+
+protected:
+    WritingSpeedOptions m_options;
+    SegmentTiming m_timing;
+    double m_x = 0.0;
+    double m_y = 0.0;
+};
+
+/**
+ * @brief 整字的书写速度与停顿统计,时间单位毫秒
+ *
+ * 任一笔画段没有时间戳时has_time为false,不参与评分
+ */
+class WritingSpeedStats
+{
+public:
+    bool has_time = false;
+    int segment_count = 0;
+    double total_time = 0.0;   //第一笔落笔到最后一笔抬笔
+    double writing_time = 0.0; //各段落笔到抬笔的时长之和
+    double gap_time = 0.0;     //段与段之间抬笔的时长之和
+    double max_gap_time = 0.0;
+    double pause_time = 0.0;   //段内停顿的时长之和
+    int pause_count = 0;
+    double mean_speed = 0.0;   //落笔期间的平均速度,每秒书写区域边长的倍数
+    double mean_segment_time = 0.0;
+    std::vector<SegmentTiming> segment_timings;
+
+    //停顿(段内停顿与段间抬笔)占总时长的比例
+    double get_pause_ratio() const
+    {
+        return total_time > 0 ? (pause_time + gap_time) / total_time : 0.0;
+    }
+    configor::json to_json() const
+    {
+        configor::json res;
+        res["has_time"] = has_time;
+        res["segment_count"] = segment_count;
+        res["total_time"] = total_time;
+        res["writing_time"] = writing_time;
+        res["gap_time"] = gap_time;
+        res["max_gap_time"] = max_gap_time;
+        res["pause_time"] = pause_time;
+        res["pause_count"] = pause_count;
+        res["pause_ratio"] = get_pause_ratio();
+        res["mean_speed"] = mean_speed;
+        res["mean_segment_time"] = mean_segment_time;
+        return res;
+    }
+};
+
+//按书写顺序汇总各笔画段的时间统计
+inline WritingSpeedStats summarize_writing_speed(const std::vector<SegmentTiming> &segment_timings)
+{
+    WritingSpeedStats stats;
+    stats.segment_timings = segment_timings;
+    stats.segment_count = (int)segment_timings.size();
+    if (segment_timings.empty() || !std::all_of(segment_timings.begin(), segment_timings.end(), [](auto &x)
+                                                { return x.has_time; }))
+    {
+        return stats;
+    }
+    stats.has_time = true;
+    auto length = 0.0;
+    for (auto i = 0; i < segment_timings.size(); ++i)
+    {
+        auto &timing = segment_timings[i];
+        stats.writing_time += timing.get_duration();
+        stats.pause_time += timing.pause_time;
+        stats.pause_count += timing.pause_count;
+        length += timing.length;
+        if (i > 0)
+        {
+            auto gap = std::max(0.0, timing.start_time - segment_timings[i - 1].end_time);
+            stats.gap_time += gap;
+            stats.max_gap_time = std::max(stats.max_gap_time, gap);
+        }
+    }
+    stats.total_time = std::max(0.0, segment_timings.back().end_time - segment_timings.front().start_time);
+    stats.mean_speed = stats.writing_time > 0 ? length / (stats.writing_time / 1000) : 0.0;
+    stats.mean_segment_time = stats.writing_time / stats.segment_count;
+    return stats;
+}
+#endif
@@ -0,0 +1,81 @@
+#ifndef STROKE_ORDER_H
+#define STROKE_ORDER_H
+#include <algorithm>
+#include <vector>
+#include "info.h"
+
+class StrokeOrderDiagnosis
+{
+public:
+    std::vector<int> written_order;         //按书写先后排列的标准字笔画序号,不含漏写的笔画
+    std::vector<int> misplaced_index_array; //写错位置的标准字笔画序号,按标准笔顺排列
+    int skip_count = 0;                     //漏写的笔画数
+    bool is_order_right() const
+    {
+        return misplaced_index_array.empty();
+    }
+};
+
+/**
+ * @brief 由笔画映射求笔顺错误
+ *
+ * 笔画段按书写时间排列,每笔以第一个笔画段的序号作为书写位置;
+ * 书写顺序与标准笔顺的最长公共子序列即书写顺序中的最长递增子序列,不在其中的笔画都是写错位置的笔画
+ * O(n^2)的动态规划只保存每个位置的长度与前驱,漏写的笔画不参与比较
+ * 长度相同时保留先写的笔画,两笔互换时报告标准笔顺靠前的一笔
+ */
+inline StrokeOrderDiagnosis diagnose_stroke_order(const std::vector<StrokeInfo> &stroke_info_array)
+{
+    StrokeOrderDiagnosis diagnosis;
+    std::vector<std::pair<int, int>> positions; //书写位置, 标准字笔画序号
+    for (auto &stroke_info : stroke_info_array)
+    {
+        if (stroke_info.is_skip || stroke_info.segment_index_array.empty())
+        {
+            ++diagnosis.skip_count;
+            continue;
+        }
+        auto position = *std::min_element(stroke_info.segment_index_array.begin(), stroke_info.segment_index_array.end());
+        positions.push_back({position, stroke_info.order});
+    }
+    std::sort(positions.begin(), positions.end());
+    for (auto &[position, order] : positions)
+    {
+        diagnosis.written_order.push_back(order);
+    }
+
+    auto n = (int)diagnosis.written_order.size();
+    std::vector<int> lengths(n, 1);
+    std::vector<int> previous(n, -1);
+    auto last = -1;
+    for (auto i = 0; i < n; ++i)
+    {
+        for (auto j = 0; j < i; ++j)
+        {
+            if (diagnosis.written_order[j] < diagnosis.written_order[i] && lengths[j] + 1 > lengths[i])
+            {
+                lengths[i] = lengths[j] + 1;
+                previous[i] = j;
+            }
+        }
+        if (last == -1 || lengths[i] > lengths[last])
+        {
+            last = i;
+        }
+    }
+    std::vector<bool> is_in_order(n, false);
+    for (auto i = last; i != -1; i = previous[i])
+    {
+        is_in_order[i] = true;
+    }
+    for (auto i = 0; i < n; ++i)
+    {
+        if (!is_in_order[i])
+        {
+            diagnosis.misplaced_index_array.push_back(diagnosis.written_order[i]);
+        }
+    }
+    std::sort(diagnosis.misplaced_index_array.begin(), diagnosis.misplaced_index_array.end());
+    return diagnosis;
+}
+#endif
@@ -0,0 +1,201 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+#include <charconv>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "request.h"
+
+//合成数据的书写区域,与dot格式的startX/startY/endX/endY一致
+constexpr double SYNTHETIC_CANVAS_SIZE = 1000.0;
+
+//保留两位小数追加到字符串,不经过printf
+inline void append_fixed(std::string &text, double value)
+{
+    auto scaled = (long long)std::llround(value * 100);
+    if (scaled < 0)
+    {
+        text += '-';
+        scaled = -scaled;
+    }
+    char buffer[24];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), scaled / 100);
+    text.append(buffer, end);
+    auto fraction = (int)(scaled % 100);
+    text += '.';
+    text += (char)('0' + fraction / 10);
+    text += (char)('0' + fraction % 10);
+}
+
+//dot格式中的书写区域
+class DotArea
+{
+public:
+    double start_x = 0;
+    double start_y = 0;
+    double end_x = SYNTHETIC_CANVAS_SIZE;
+    double end_y = SYNTHETIC_CANVAS_SIZE;
+};
+
+/**
+ * @brief 生成一行dot格式的笔画段
+ *
+ * @param points 书写区域内的坐标
+ * @param times 每个点的时间戳(毫秒),为空时不输出t字段
+ */
+inline std::string make_dot_line(const std::vector<cv::Point2d> &points, const std::vector<double> &times = {}, DotArea area = DotArea())
+{
+    std::string line;
+    line.reserve(80 + points.size() * (times.empty() ? 26 : 36));
+    line += "{\"startX\":";
+    append_fixed(line, area.start_x);
+    line += ",\"startY\":";
+    append_fixed(line, area.start_y);
+    line += ",\"endX\":";
+    append_fixed(line, area.end_x);
+    line += ",\"endY\":";
+    append_fixed(line, area.end_y);
+    line += ",\"list\":[";
+    for (auto i = 0; i < points.size(); ++i)
+    {
+        if (i != 0)
+        {
+            line += ',';
+        }
+        line += "{\"x\":";
+        append_fixed(line, points[i].x);
+        line += ",\"y\":";
+        append_fixed(line, points[i].y);
+        if (!times.empty())
+        {
+            line += ",\"t\":";
+            append_fixed(line, times[i]);
+        }
+        line += '}';
+    }
+    line += "]}";
+    return line;
+}
+
+//部件个数由结构类型决定
+inline int get_layout_struction_count(const std::string &layout)
+{
+    if (layout == "⿰" || layout == "⿱")
+    {
+        return 2;
+    }
+    if (layout == "⿲" || layout == "⿳")
+    {
+        return 3;
+    }
+    return 1;
+}
+
+//结构类型中第index个部件的区域,书写区域坐标
+inline cv::Rect get_layout_region(const std::string &layout, int index)
+{
+    auto size = (int)SYNTHETIC_CANVAS_SIZE;
+    auto margin = size / 10;
+    auto inner = size - 2 * margin;
+    auto count = get_layout_struction_count(layout);
+    if (layout == "⿰" || layout == "⿲")
+    {
+        return cv::Rect(margin + inner * index / count, margin, inner / count, inner);
+    }
+    if (layout == "⿱" || layout == "⿳")
+    {
+        return cv::Rect(margin, margin + inner * index / count, inner, inner / count);
+    }
+    return cv::Rect(margin, margin, inner, inner);
+}
+
+class SyntheticOptions
+{
+public:
+    int stroke_count = 5;
+    std::string layout = " "; //" ", "⿰", "⿱", "⿲", "⿳"
+    int points_per_stroke = 32;
+    unsigned int seed = 0;
+};
+
+/**
+ * @brief 合成一个字:在各部件区域内随机放置横竖撇捺提,测试字为标准字加少量抖动
+ *
+ * stroke_count需不小于部件个数,config_line由调用者填写
+ */
+inline ScoreRequest make_synthetic_request(SyntheticOptions options)
+{
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> jitter(0.0, 3.0);
+    const char *names[] = {"横", "竖", "撇", "捺", "提"};
+    ScoreRequest request;
+    auto struction_count = get_layout_struction_count(options.layout);
+    std::vector<int> stroke_struction_index_array(options.stroke_count, 0);
+    request.char_info.name = "synthetic";
+    request.char_info.type = options.layout;
+    request.char_info.warp_score = 0;
+    for (auto k = 0; k < struction_count; ++k)
+    {
+        StructionInfo struction_info;
+        for (auto i = k * options.stroke_count / struction_count; i < (k + 1) * options.stroke_count / struction_count; ++i)
+        {
+            struction_info.stroke_index_array.push_back(i);
+            stroke_struction_index_array[i] = k;
+        }
+        request.struction_info_array.push_back(struction_info);
+        request.char_info.struction_index_array.push_back(k);
+    }
+    for (auto i = 0; i < options.stroke_count; ++i)
+    {
+        auto region = get_layout_region(options.layout, stroke_struction_index_array[i]);
+        auto kind = i % 5;
+        //起点与方向,单位为区域宽高
+        double x0 = 0.2 + 0.6 * uniform(random), y0 = 0.2 + 0.6 * uniform(random);
+        double dx = 0, dy = 0;
+        switch (kind)
+        {
+        case 0:
+            x0 = 0.1, dx = 0.8;
+            break;
+        case 1:
+            y0 = 0.1, dy = 0.8;
+            break;
+        case 2:
+            x0 = 0.7, y0 = 0.1, dx = -0.6, dy = 0.8;
+            break;
+        case 3:
+            x0 = 0.3, y0 = 0.1, dx = 0.6, dy = 0.8;
+            break;
+        case 4:
+            x0 = 0.2, y0 = 0.8, dx = 0.6, dy = -0.3;
+            break;
+        }
+        auto bend = 0.05 * (uniform(random) - 0.5);
+        std::vector<cv::Point2d> standard_points;
+        std::vector<cv::Point2d> evaluate_points;
+        for (auto j = 0; j < options.points_per_stroke; ++j)
+        {
+            auto t = options.points_per_stroke == 1 ? 0.0 : (double)j / (options.points_per_stroke - 1);
+            auto u = x0 + dx * t - dy * bend * std::sin(M_PI * t);
+            auto v = y0 + dy * t + dx * bend * std::sin(M_PI * t);
+            cv::Point2d point(region.x + u * region.width, region.y + v * region.height);
+            standard_points.push_back(point);
+            evaluate_points.push_back(cv::Point2d(point.x + jitter(random), point.y + jitter(random)));
+        }
+        request.standard_lines.push_back(make_dot_line(standard_points));
+        request.evaluate_lines.push_back(make_dot_line(evaluate_points));
+        StrokeInfo stroke_info;
+        stroke_info.name = names[kind];
+        stroke_info.order = i;
+        stroke_info.is_valid = true;
+        stroke_info.is_skip = false;
+        stroke_info.is_reliable = true;
+        stroke_info.segment_index_array = {i};
+        request.stroke_info_array.push_back(stroke_info);
+    }
+    return request;
+}
+#endif
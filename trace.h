@@ -0,0 +1,228 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+//一个开始或结束事件
+class TraceEvent
+{
+public:
+    std::string name;
+    const char *category;
+    char phase;             // 'B'开始, 'E'结束
+    std::uint64_t time_ns;  //相对Tracer创建时刻
+};
+
+//一个线程的事件缓冲,只由本线程写入
+class TraceBuffer
+{
+public:
+    int thread_id = 0;
+    std::vector<TraceEvent> events;
+    std::uint64_t dropped_count = 0;
+    std::size_t open_count = 0; //已记录开始、尚未结束的作用域数,为其结束事件预留位置
+    std::mutex mutex; //只在写出或清空时与本线程竞争
+};
+
+/**
+ * @brief 可选的执行轨迹,输出Chrome trace json,可在chrome://tracing或Perfetto中打开
+ *
+ * 默认关闭,关闭时每个作用域只有一次原子读
+ * 每个线程写自己的缓冲,缓冲满后丢弃新的作用域并计数;
+ * 是否记录在开始时决定,记录了开始的作用域总为结束事件预留位置,开始与结束总是成对
+ */
+class Tracer
+{
+public:
+    static Tracer &instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+    bool is_enabled() const
+    {
+        return m_is_enabled.load(std::memory_order_relaxed);
+    }
+    void set_enabled(bool is_enabled)
+    {
+        m_is_enabled.store(is_enabled, std::memory_order_relaxed);
+    }
+    //每个线程最多保留的事件数
+    void set_max_event_count(std::size_t max_event_count)
+    {
+        m_max_event_count.store(max_event_count, std::memory_order_relaxed);
+    }
+    /**
+     * @brief 开始一个作用域
+     *
+     * @return 是否记录,为true时需调用一次end
+     */
+    bool begin(const char *category, std::string name)
+    {
+        auto time_ns = get_time_ns();
+        auto &buffer = get_thread_buffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        //本事件与其结束事件,加上已开始的作用域预留的结束事件
+        if (buffer.events.size() + buffer.open_count + 2 > m_max_event_count.load(std::memory_order_relaxed))
+        {
+            ++buffer.dropped_count;
+            return false;
+        }
+        buffer.events.push_back({std::move(name), category, 'B', time_ns});
+        ++buffer.open_count;
+        return true;
+    }
+    //结束begin返回true的作用域,位置已在开始时预留
+    void end(const char *category)
+    {
+        auto time_ns = get_time_ns();
+        auto &buffer = get_thread_buffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back({std::string(), category, 'E', time_ns});
+        if (buffer.open_count > 0)
+        {
+            --buffer.open_count;
+        }
+    }
+    /**
+     * @brief 把所有线程的事件写成Chrome trace json
+     *
+     * @param is_clear 写出后清空缓冲
+     * @return 写出的事件数
+     */
+    std::size_t write_chrome_trace(const std::string &path, bool is_clear = true)
+    {
+        std::ofstream file(path);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("cannot open trace output " + path);
+        }
+        std::size_t event_count = 0;
+        std::string text;
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto is_first = true;
+        for (auto &buffer : m_buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            text.clear();
+            text += is_first ? "" : ",";
+            is_first = false;
+            text += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(buffer->thread_id) +
+                    ",\"args\":{\"name\":\"worker " + std::to_string(buffer->thread_id) +
+                    (buffer->dropped_count != 0 ? " (dropped " + std::to_string(buffer->dropped_count) + ")" : std::string()) + "\"}}";
+            for (auto &event : buffer->events)
+            {
+                text += ",{\"ph\":\"";
+                text += event.phase;
+                text += "\",\"cat\":\"";
+                text += event.category;
+                text += "\",\"pid\":1,\"tid\":" + std::to_string(buffer->thread_id) + ",\"ts\":";
+                //微秒,保留纳秒精度
+                text += std::to_string(event.time_ns / 1000) + "." + std::to_string(1000 + event.time_ns % 1000).substr(1);
+                if (event.phase == 'B')
+                {
+                    text += ",\"name\":\"";
+                    append_escaped(text, event.name);
+                    text += '"';
+                }
+                text += '}';
+            }
+            event_count += buffer->events.size();
+            file << text;
+            if (is_clear)
+            {
+                buffer->events.clear();
+                buffer->dropped_count = 0;
+            }
+        }
+        file << "]}\n";
+        return event_count;
+    }
+
+protected:
+    std::uint64_t get_time_ns() const
+    {
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+    }
+    TraceBuffer &get_thread_buffer()
+    {
+        thread_local std::shared_ptr<TraceBuffer> buffer;
+        if (!buffer)
+        {
+            buffer = std::make_shared<TraceBuffer>();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            buffer->thread_id = (int)m_buffers.size() + 1;
+            m_buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+    static void append_escaped(std::string &text, const std::string &value)
+    {
+        for (auto c : value)
+        {
+            if (c == '"' || c == '\\')
+            {
+                text += '\\';
+                text += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                text += ' ';
+            }
+            else
+            {
+                text += c;
+            }
+        }
+    }
+    std::atomic<bool> m_is_enabled{false};
+    std::atomic<std::size_t> m_max_event_count{1 << 20};
+    std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<TraceBuffer>> m_buffers;
+};
+
+/**
+ * @brief 作用域事件,构造时开始,析构时结束
+ *
+ * make_name只在开启轨迹时调用,关闭时不拼接名字
+ */
+class TraceScope
+{
+public:
+    template <typename MakeName>
+    TraceScope(const char *category, MakeName &&make_name) : m_category(category), m_is_enabled(Tracer::instance().is_enabled())
+    {
+        if (m_is_enabled)
+        {
+            m_is_enabled = Tracer::instance().begin(m_category, make_name());
+        }
+    }
+    TraceScope(const char *category, const char *name) : TraceScope(category, [name]()
+                                                                     { return std::string(name); })
+    {
+    }
+    ~TraceScope()
+    {
+        if (m_is_enabled)
+        {
+            Tracer::instance().end(m_category);
+        }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+protected:
+    const char *m_category;
+    bool m_is_enabled;
+};
+#endif
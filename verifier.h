@@ -0,0 +1,230 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "mapper.h"
+
+enum class CharacterCheck
+{
+    right,
+    wrong,
+    unknown, //无法确定,交给远端识别
+};
+
+inline const char *get_character_check_name(CharacterCheck check)
+{
+    static const char *names[] = {"right", "wrong", "unknown"};
+    return names[(int)check];
+}
+
+class CharacterVerifierOptions
+{
+public:
+    int grid_size = 12;                 //占据网格的边长格数
+    int signature_size = 16;            //凸包签名的方向数
+    double right_grid_similarity = 0.8; //判为正确所需的最低网格相似度
+    double wrong_grid_similarity = 0.45;
+    double right_hull_distance = 0.06;  //判为正确所允许的最大凸包签名距离
+    double wrong_hull_distance = 0.15;
+    int right_stroke_count_diff = 1;    //判为正确所允许的最大笔画段数差,连笔与断笔会使其不为0
+    double wrong_stroke_count_ratio = 0.5; //笔画段数差超过标准笔画数的该比例时视为错字的证据
+    //预判结果是否覆盖调用方传入的is_character_right;以上阈值未在语料上标定,
+    //默认只记录预判,由调用方在unknown之外跳过远端识别,确认精确率后才可开启
+    bool is_override_verdict = false;
+};
+
+//一个字的紧凑形状描述,坐标按外接矩形的长边归一化并居中
+class CharacterShape
+{
+public:
+    int stroke_count = 0;
+    int point_count = 0;
+    std::vector<unsigned char> grid; //被笔迹经过的格为1
+    std::vector<double> signature;   //凸包在各方向上的支撑函数,即凸包到中心沿该方向的最远距离
+};
+
+class CharacterCheckResult
+{
+public:
+    CharacterCheck check = CharacterCheck::unknown;
+    int standard_stroke_count = 0;
+    int evaluate_stroke_count = 0;
+    double grid_similarity = 0.0; //允许1格偏差的占据网格F1
+    double hull_distance = 0.0;   //凸包签名的平均差
+};
+
+/**
+ * @brief 本地错字预判
+ *
+ * 比较笔画段数、归一化占据网格与凸包签名三项:三项都接近时判为正确,至少两项明显不同时判为错字,
+ * 其余情况为unknown,只有这部分需要送远端识别
+ * 标准字的描述可由get_shape预先求出并复用,Manager::check_character按标准字缓存
+ */
+class CharacterVerifier
+{
+public:
+    CharacterVerifier(CharacterVerifierOptions options = CharacterVerifierOptions()) : m_options(options)
+    {
+    }
+    CharacterCheckResult check(const std::vector<std::string> &standard_lines, const std::vector<std::string> &evaluate_lines) const
+    {
+        return check(get_shape(standard_lines), get_shape(evaluate_lines));
+    }
+    CharacterCheckResult check(const CharacterShape &standard, const CharacterShape &evaluate) const
+    {
+        CharacterCheckResult result;
+        result.standard_stroke_count = standard.stroke_count;
+        result.evaluate_stroke_count = evaluate.stroke_count;
+        if (standard.point_count == 0 || evaluate.point_count == 0)
+        {
+            return result;
+        }
+        result.grid_similarity = get_grid_similarity(standard.grid, evaluate.grid);
+        auto hull_distance = 0.0;
+        for (auto i = 0; i < standard.signature.size(); ++i)
+        {
+            hull_distance += std::abs(standard.signature[i] - evaluate.signature[i]);
+        }
+        result.hull_distance = hull_distance / std::max<std::size_t>(1, standard.signature.size());
+
+        auto stroke_count_diff = std::abs(standard.stroke_count - evaluate.stroke_count);
+        if (result.grid_similarity >= m_options.right_grid_similarity &&
+            result.hull_distance <= m_options.right_hull_distance &&
+            stroke_count_diff <= m_options.right_stroke_count_diff)
+        {
+            result.check = CharacterCheck::right;
+            return result;
+        }
+        auto wrong_count = 0;
+        wrong_count += result.grid_similarity < m_options.wrong_grid_similarity;
+        wrong_count += result.hull_distance > m_options.wrong_hull_distance;
+        wrong_count += stroke_count_diff > std::max(1.0, m_options.wrong_stroke_count_ratio * standard.stroke_count);
+        if (wrong_count >= 2)
+        {
+            result.check = CharacterCheck::wrong;
+        }
+        return result;
+    }
+    CharacterShape get_shape(const std::vector<std::string> &lines) const
+    {
+        return get_shape(parse_dot_lines(lines));
+    }
+    CharacterShape get_shape(const std::vector<DotLine> &dot_lines) const
+    {
+        std::vector<std::vector<cv::Point2d>> segments;
+        for (auto &dot_line : dot_lines)
+        {
+            segments.push_back(dot_line.points);
+        }
+        return get_shape(segments);
+    }
+    CharacterShape get_shape(const std::vector<std::vector<cv::Point2d>> &segments) const
+    {
+        CharacterShape shape;
+        auto grid_size = std::max(1, m_options.grid_size);
+        shape.stroke_count = (int)segments.size();
+        shape.grid.assign(grid_size * grid_size, 0);
+        shape.signature.assign(std::max(1, m_options.signature_size), 0.0);
+
+        auto infinity = std::numeric_limits<double>::infinity();
+        auto min_x = infinity, max_x = -infinity, min_y = infinity, max_y = -infinity;
+        for (auto &points : segments)
+        {
+            for (auto &point : points)
+            {
+                min_x = std::min(min_x, point.x);
+                max_x = std::max(max_x, point.x);
+                min_y = std::min(min_y, point.y);
+                max_y = std::max(max_y, point.y);
+                ++shape.point_count;
+            }
+        }
+        if (shape.point_count == 0)
+        {
+            return shape;
+        }
+        //按长边缩放到0-1并居中,只有一个点时不缩放
+        auto scale = std::max(max_x - min_x, max_y - min_y);
+        scale = scale > 0 ? scale : 1.0;
+        cv::Point2d center((min_x + max_x) / 2, (min_y + max_y) / 2);
+        auto normalize = [&](const cv::Point2d &point)
+        {
+            return cv::Point2d((point.x - center.x) / scale + 0.5, (point.y - center.y) / scale + 0.5);
+        };
+        auto mark = [&](const cv::Point2d &point)
+        {
+            auto x = std::clamp((int)(point.x * grid_size), 0, grid_size - 1);
+            auto y = std::clamp((int)(point.y * grid_size), 0, grid_size - 1);
+            shape.grid[y * grid_size + x] = 1;
+        };
+        for (auto &points : segments)
+        {
+            for (auto i = 0; i < points.size(); ++i)
+            {
+                auto point = normalize(points[i]);
+                mark(point);
+                for (auto k = 0; k < shape.signature.size(); ++k)
+                {
+                    auto angle = 2 * CV_PI * k / shape.signature.size();
+                    shape.signature[k] = std::max(shape.signature[k], (point.x - 0.5) * std::cos(angle) + (point.y - 0.5) * std::sin(angle));
+                }
+                if (i == 0)
+                {
+                    continue;
+                }
+                //相邻两点之间按半格步长补点,稀疏的点也能连续经过网格
+                auto previous = normalize(points[i - 1]);
+                auto step_count = (int)std::ceil(cv::norm(point - previous) * grid_size * 2);
+                for (auto step = 1; step < step_count; ++step)
+                {
+                    mark(previous + (point - previous) * ((double)step / step_count));
+                }
+            }
+        }
+        return shape;
+    }
+
+protected:
+    //一方被占据的格在另一方的3x3邻域内也被占据即算命中,取两方命中率的调和平均
+    double get_grid_similarity(const std::vector<unsigned char> &standard_grid, const std::vector<unsigned char> &evaluate_grid) const
+    {
+        auto grid_size = std::max(1, m_options.grid_size);
+        auto get_hit_ratio = [&](const std::vector<unsigned char> &grid, const std::vector<unsigned char> &other)
+        {
+            auto count = 0;
+            auto hit_count = 0;
+            for (auto y = 0; y < grid_size; ++y)
+            {
+                for (auto x = 0; x < grid_size; ++x)
+                {
+                    if (grid[y * grid_size + x] == 0)
+                    {
+                        continue;
+                    }
+                    ++count;
+                    auto is_hit = false;
+                    for (auto dy = -1; dy <= 1 && !is_hit; ++dy)
+                    {
+                        for (auto dx = -1; dx <= 1 && !is_hit; ++dx)
+                        {
+                            auto nx = x + dx;
+                            auto ny = y + dy;
+                            is_hit = nx >= 0 && nx < grid_size && ny >= 0 && ny < grid_size && other[ny * grid_size + nx] != 0;
+                        }
+                    }
+                    hit_count += is_hit;
+                }
+            }
+            return count == 0 ? 0.0 : (double)hit_count / count;
+        };
+        auto precision = get_hit_ratio(evaluate_grid, standard_grid);
+        auto recall = get_hit_ratio(standard_grid, evaluate_grid);
+        return precision + recall == 0 ? 0.0 : 2 * precision * recall / (precision + recall);
+    }
+    CharacterVerifierOptions m_options;
+};
+#endif